@@ -1,26 +1,18 @@
-QT       += core gui widgets network
+TEMPLATE = subdirs
 
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+# core: download engine, QtCore + QtNetwork only
+# app:  Qt Widgets GUI
+# cli:  headless front end for scripts, CI and cron
+# bench: offline throughput benchmark against a local test server
+# tests: QtTest unit tests of the engine's pure parts ("make check")
+SUBDIRS += \
+    core \
+    app \
+    cli \
+    bench \
+    tests
 
-CONFIG += c++17
-
-# You can make your code fail to compile if it uses deprecated APIs.
-# In order to do so, uncomment the following line.
-#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
-
-SOURCES += \
-    downloadmanager.cpp \
-    main.cpp \
-    mainwindow.cpp
-
-HEADERS += \
-    downloadmanager.h \
-    mainwindow.h
-
-FORMS += \
-    mainwindow.ui
-
-# Default rules for deployment.
-qnx: target.path = /tmp/$${TARGET}/bin
-else: unix:!android: target.path = /opt/$${TARGET}/bin
-!isEmpty(target.path): INSTALLS += target
+app.depends = core
+cli.depends = core
+bench.depends = core
+tests.depends = core
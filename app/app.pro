@@ -0,0 +1,31 @@
+QT       += core gui widgets network
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+CONFIG += c++17
+TARGET = FastDoms
+
+# You can make your code fail to compile if it uses deprecated APIs.
+# In order to do so, uncomment the following line.
+#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
+
+include(../core/core.pri)
+
+SOURCES += \
+    logmodel.cpp \
+    main.cpp \
+    mainwindow.cpp \
+    segmentmodel.cpp
+
+HEADERS += \
+    logmodel.h \
+    mainwindow.h \
+    segmentmodel.h
+
+FORMS += \
+    mainwindow.ui
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
@@ -0,0 +1,73 @@
+#include "logmodel.h"
+#include <QTimer>
+
+// Pending lines reach the view at most this often.
+static const int FlushIntervalMs = 100;
+
+LogModel::LogModel(int capacity, QObject *parent)
+    : QAbstractListModel(parent), lines(qMax(1, capacity)), first(0), count(0) {
+    flushTimer = new QTimer(this);
+    flushTimer->setSingleShot(true);
+    flushTimer->setInterval(FlushIntervalMs);
+    connect(flushTimer, &QTimer::timeout, this, &LogModel::flush);
+}
+
+int LogModel::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : count;
+}
+
+QVariant LogModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || index.row() >= count || (role != Qt::DisplayRole && role != Qt::ToolTipRole)) {
+        return QVariant();
+    }
+    return lines[(first + index.row()) % lines.size()];
+}
+
+void LogModel::append(const QString &line) {
+    pending.append(line);
+    if (!flushTimer->isActive()) {
+        flushTimer->start();
+    }
+}
+
+void LogModel::clear() {
+    beginResetModel();
+    for (QString &line : lines) {
+        line.clear();
+    }
+    first = 0;
+    count = 0;
+    pending.clear();
+    flushTimer->stop();
+    endResetModel();
+}
+
+void LogModel::flush() {
+    if (pending.isEmpty()) {
+        return;
+    }
+    int capacity = lines.size();
+    if (pending.size() > capacity) {
+        pending = pending.mid(pending.size() - capacity);
+    }
+
+    // Room first: the oldest rows leave from the top.
+    int overflow = count + pending.size() - capacity;
+    if (overflow > 0) {
+        beginRemoveRows(QModelIndex(), 0, overflow - 1);
+        for (int i = 0; i < overflow; ++i) {
+            lines[(first + i) % capacity].clear();
+        }
+        first = (first + overflow) % capacity;
+        count -= overflow;
+        endRemoveRows();
+    }
+
+    beginInsertRows(QModelIndex(), count, count + pending.size() - 1);
+    for (const QString &line : pending) {
+        lines[(first + count) % capacity] = line;
+        count++;
+    }
+    endInsertRows();
+    pending.clear();
+}
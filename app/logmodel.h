@@ -0,0 +1,36 @@
+#ifndef LOGMODEL_H
+#define LOGMODEL_H
+
+#include <QAbstractListModel>
+#include <QStringList>
+#include <QVector>
+
+class QTimer;
+
+// Activity log kept in a ring buffer: past capacity the oldest lines go, so
+// memory and view cost stay flat however long the session. Lines are
+// appended to the view in batches, not one insertion each.
+class LogModel : public QAbstractListModel {
+    Q_OBJECT
+
+public:
+    explicit LogModel(int capacity, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    // Shown at the next flush.
+    void append(const QString &line);
+    void clear();
+
+private:
+    void flush();
+
+    QVector<QString> lines;
+    int first;
+    int count;
+    QStringList pending;
+    QTimer *flushTimer;
+};
+
+#endif
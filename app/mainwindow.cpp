@@ -6,8 +6,15 @@
 #include <QHeaderView>
 #include <QGroupBox>
 #include <QFrame>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QScrollBar>
+#include "metalink.h"
 
-MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), isPaused(false) {
+// Lines kept in the activity log; older ones are dropped.
+static const int LogCapacity = 10000;
+
+MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), followLog(true), isPaused(false) {
     setWindowTitle("Téléchargeur Multi-Thread Rapide");
     setMinimumSize(900, 700);
 
@@ -21,6 +28,11 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), isPaused(false) {
     connect(pauseButton, &QPushButton::clicked, this, &MainWindow::pauseDownload);
     connect(cancelButton, &QPushButton::clicked, this, &MainWindow::cancelDownload);
 
+    // The limit applies immediately, even during a download
+    connect(rateLimitInput, &QSpinBox::valueChanged, this, [this](int value) {
+        downloadManager->setRateLimit(qint64(value) * 1024);
+    });
+
     connect(browseButton, &QPushButton::clicked, this, [this]() {
         QString filePath = QFileDialog::getSaveFileName(this, "Enregistrer le fichier", "", "Tous les fichiers (*)");
         if (!filePath.isEmpty()) {
@@ -32,6 +44,7 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), isPaused(false) {
     connect(downloadManager, &DownloadManager::downloadFinished, this, &MainWindow::onDownloadFinished);
     connect(downloadManager, &DownloadManager::logMessage, this, &MainWindow::onLogMessage);
     connect(downloadManager, &DownloadManager::threadProgressUpdated, this, &MainWindow::onThreadProgress);
+    connect(downloadManager, &DownloadManager::threadCountChanged, this, &MainWindow::onThreadCountChanged);
     connect(downloadManager, &DownloadManager::speedUpdated, this, [this](const QString &speed) {
         speedLabel->setText("Vitesse: " + speed);
     });
@@ -63,7 +76,7 @@ void MainWindow::setupUI() {
     QLabel *urlLabel = new QLabel("🌐 URL du fichier:", this);
     urlLabel->setStyleSheet("font-weight: bold; font-size: 13px;");
     urlInput = new QLineEdit(this);
-    urlInput->setPlaceholderText("https://exemple.com/fichier.zip");
+    urlInput->setPlaceholderText("https://exemple.com/fichier.zip — plusieurs URL séparées par des espaces pour les miroirs, ou un fichier .meta4");
     urlInput->setMinimumHeight(35);
 
     urlLayout->addWidget(urlLabel);
@@ -84,6 +97,61 @@ void MainWindow::setupUI() {
     urlLayout->addWidget(pathLabel);
     urlLayout->addLayout(pathLayout);
 
+    QLabel *checksumLabel = new QLabel("🔐 Empreinte attendue (facultatif):", this);
+    checksumLabel->setStyleSheet("font-weight: bold; font-size: 13px;");
+    checksumInput = new QLineEdit(this);
+    checksumInput->setPlaceholderText("sha256:…, sha512:…, sha1:…, md5:… ou crc32c:…");
+    checksumInput->setMinimumHeight(35);
+
+    urlLayout->addWidget(checksumLabel);
+    urlLayout->addWidget(checksumInput);
+
+    QHBoxLayout *connectionsLayout = new QHBoxLayout();
+    QLabel *connectionsLabel = new QLabel("🔗 Connexions:", this);
+    connectionsLabel->setStyleSheet("font-weight: bold; font-size: 13px;");
+    connectionsInput = new QSpinBox(this);
+    connectionsInput->setRange(0, 128);
+    connectionsInput->setSpecialValueText("Auto");
+    connectionsInput->setValue(0);
+    minConnectionsInput = new QSpinBox(this);
+    minConnectionsInput->setRange(1, 128);
+    minConnectionsInput->setValue(4);
+    minConnectionsInput->setPrefix("Min: ");
+    maxConnectionsInput = new QSpinBox(this);
+    maxConnectionsInput->setRange(1, 128);
+    maxConnectionsInput->setValue(32);
+    maxConnectionsInput->setPrefix("Max: ");
+    retriesInput = new QSpinBox(this);
+    retriesInput->setRange(0, 50);
+    retriesInput->setValue(5);
+    retriesInput->setPrefix("Tentatives: ");
+
+    rateLimitInput = new QSpinBox(this);
+    rateLimitInput->setRange(0, 10000000);
+    rateLimitInput->setSingleStep(256);
+    rateLimitInput->setSpecialValueText("Débit illimité");
+    rateLimitInput->setPrefix("Débit max: ");
+    rateLimitInput->setSuffix(" KB/s");
+
+    http2Input = new QCheckBox("HTTP/2", this);
+    http2Input->setToolTip("Segments en flux multiplexés sur une seule connexion HTTP/2 (serveurs https)");
+
+    connect(connectionsInput, &QSpinBox::valueChanged, this, [this](int value) {
+        minConnectionsInput->setEnabled(value == 0);
+        maxConnectionsInput->setEnabled(value == 0);
+    });
+
+    connectionsLayout->addWidget(connectionsLabel);
+    connectionsLayout->addWidget(connectionsInput);
+    connectionsLayout->addWidget(minConnectionsInput);
+    connectionsLayout->addWidget(maxConnectionsInput);
+    connectionsLayout->addWidget(retriesInput);
+    connectionsLayout->addWidget(rateLimitInput);
+    connectionsLayout->addWidget(http2Input);
+    connectionsLayout->addStretch();
+
+    urlLayout->addLayout(connectionsLayout);
+
     mainLayout->addWidget(urlGroup);
 
     // ===== CONTROL BUTTONS =====
@@ -140,11 +208,16 @@ void MainWindow::setupUI() {
     mainLayout->addWidget(progressGroup);
 
     // ===== THREAD TABLE =====
-    QGroupBox *threadGroup = new QGroupBox("État des threads (10 threads parallèles)", this);
+    QGroupBox *threadGroup = new QGroupBox("État des threads", this);
     QVBoxLayout *threadLayout = new QVBoxLayout(threadGroup);
 
-    threadTable = new QTableWidget(10, 3, this);
-    threadTable->setHorizontalHeaderLabels({"Thread", "Progression", "État"});
+    // Fixed row heights: the view never measures rows, whatever their number.
+    segmentModel = new SegmentModel(this);
+    threadTable = new QTableView(this);
+    threadTable->setModel(segmentModel);
+    threadTable->setItemDelegateForColumn(SegmentModel::ProgressColumn, new ProgressDelegate(threadTable));
+    threadTable->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    threadTable->verticalHeader()->setDefaultSectionSize(26);
     threadTable->horizontalHeader()->setStretchLastSection(true);
     threadTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Fixed);
     threadTable->horizontalHeader()->setSectionResizeMode(1, QHeaderView::Stretch);
@@ -153,20 +226,6 @@ void MainWindow::setupUI() {
     threadTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
     threadTable->setSelectionMode(QAbstractItemView::NoSelection);
 
-    // Initialize table
-    for (int i = 0; i < 10; i++) {
-        threadTable->setItem(i, 0, new QTableWidgetItem(QString("Thread %1").arg(i)));
-
-        QProgressBar *bar = new QProgressBar();
-        bar->setRange(0, 100);
-        bar->setValue(0);
-        bar->setTextVisible(true);
-        bar->setMaximumHeight(20);
-        threadTable->setCellWidget(i, 1, bar);
-
-        threadTable->setItem(i, 2, new QTableWidgetItem("⏳ En attente"));
-    }
-
     threadLayout->addWidget(threadTable);
     mainLayout->addWidget(threadGroup);
 
@@ -174,11 +233,25 @@ void MainWindow::setupUI() {
     QGroupBox *logGroup = new QGroupBox("Journal d'activité", this);
     QVBoxLayout *logLayout = new QVBoxLayout(logGroup);
 
-    logOutput = new QTextEdit(this);
-    logOutput->setReadOnly(true);
-    logOutput->setMaximumHeight(120);
+    logModel = new LogModel(LogCapacity, this);
+    logView = new QListView(this);
+    logView->setModel(logModel);
+    logView->setUniformItemSizes(true);
+    logView->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    logView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    logView->setMaximumHeight(120);
+
+    // The log follows new lines unless the user scrolled up to read.
+    connect(logView->verticalScrollBar(), &QScrollBar::valueChanged, this, [this](int value) {
+        followLog = value == logView->verticalScrollBar()->maximum();
+    });
+    connect(logModel, &LogModel::rowsInserted, this, [this]() {
+        if (followLog) {
+            logView->scrollToBottom();
+        }
+    });
 
-    logLayout->addWidget(logOutput);
+    logLayout->addWidget(logView);
     mainLayout->addWidget(logGroup);
 }
 
@@ -230,7 +303,7 @@ void MainWindow::setupStyles() {
                 stop:0 #4CAF50, stop:1 #8BC34A);
             border-radius: 3px;
         }
-        QTextEdit {
+        QListView {
             border: 2px solid #ddd;
             border-radius: 5px;
             background-color: #fafafa;
@@ -238,7 +311,7 @@ void MainWindow::setupStyles() {
             font-size: 11px;
             color : black;
         }
-        QTableWidget {
+        QTableView {
             border: 2px solid #ddd;
             border-radius: 5px;
             background-color: white;
@@ -268,44 +341,79 @@ void MainWindow::startDownload() {
         return;
     }
 
+    // Several URLs are mirrors of the same file; a local Metalink lists them itself.
+    QStringList urls = url.split(QRegularExpression("\\s+"), Qt::SkipEmptyParts);
+    Metalink metalink;
+    if (urls.size() == 1 && (url.endsWith(".meta4") || url.endsWith(".metalink")) && QFileInfo::exists(url)) {
+        QString error;
+        if (!Metalink::load(url, metalink, &error)) {
+            QMessageBox::warning(this, "⚠ Erreur", "Fichier Metalink illisible: " + error);
+            return;
+        }
+        urls = metalink.urls;
+    }
+
+    IntegrityVerifier::Algorithm algorithm = metalink.hashAlgorithm;
+    QByteArray digest = metalink.hash;
+    QString checksum = checksumInput->text().trimmed();
+    if (!checksum.isEmpty() && !IntegrityVerifier::parseDigest(checksum, algorithm, digest)) {
+        QMessageBox::warning(this, "⚠ Erreur", "Empreinte invalide. Format attendu: algorithme:hexadécimal, par exemple sha256:9f86d0…");
+        return;
+    }
+
     downloadButton->setEnabled(false);
     pauseButton->setEnabled(true);
+    pauseButton->setText("⏸ PAUSE");
     cancelButton->setEnabled(true);
+    isPaused = false;
 
     globalProgressBar->setValue(0);
     statusLabel->setText("🚀 Démarrage...");
-    logOutput->clear();
-
-    // Reset thread table
-    for (int i = 0; i < 10; i++) {
-        QProgressBar *bar = qobject_cast<QProgressBar*>(threadTable->cellWidget(i, 1));
-        if (bar) bar->setValue(0);
-        threadTable->item(i, 2)->setText("⏳ En attente");
-    }
-
-    downloadManager->startDownload(url, savePath);
+    logModel->clear();
+    followLog = true;
+
+    // Rows are added as the manager creates workers
+    segmentModel->clear();
+
+    downloadManager->setConnectionLimits(minConnectionsInput->value(), maxConnectionsInput->value());
+    downloadManager->setFixedConnections(connectionsInput->value());
+    downloadManager->setMaxRetries(retriesInput->value());
+    downloadManager->setProtocol(http2Input->isChecked() ? DownloadManager::Http2 : DownloadManager::Http1);
+    downloadManager->setExpectedDigest(algorithm, digest);
+    downloadManager->setPieceDigests(metalink.pieceAlgorithm, metalink.pieceLength, metalink.pieces);
+    downloadManager->setMirrors(urls.mid(1));
+    downloadManager->startDownload(urls.first(), savePath);
 }
 
 void MainWindow::pauseDownload() {
     isPaused = !isPaused;
     if (isPaused) {
+        downloadManager->pause();
         pauseButton->setText("▶ REPRENDRE");
         statusLabel->setText("⏸ En pause");
     } else {
+        downloadManager->resume();
         pauseButton->setText("⏸ PAUSE");
         statusLabel->setText("🚀 Téléchargement en cours...");
     }
 }
 
 void MainWindow::cancelDownload() {
+    QMessageBox::StandardButton answer = QMessageBox::question(
+        this, "✖ Annuler", "Supprimer aussi le fichier partiel ?\n(Non: le téléchargement pourra reprendre plus tard)",
+        QMessageBox::Yes | QMessageBox::No | QMessageBox::Cancel, QMessageBox::No);
+    if (answer == QMessageBox::Cancel) {
+        return;
+    }
+    downloadManager->cancel(answer == QMessageBox::Yes);
+
+    isPaused = false;
+    pauseButton->setText("⏸ PAUSE");
     downloadButton->setEnabled(true);
     pauseButton->setEnabled(false);
     cancelButton->setEnabled(false);
     statusLabel->setText("✖ Téléchargement annulé");
-
-    for (int i = 0; i < 10; i++) {
-        threadTable->item(i, 2)->setText("✖ Annulé");
-    }
+    segmentModel->setAllStates(SegmentModel::Cancelled);
 }
 
 void MainWindow::onDownloadProgress(int percentage) {
@@ -321,11 +429,7 @@ void MainWindow::onDownloadFinished(bool success, const QString &message) {
     if (success) {
         statusLabel->setText("✅ Terminé avec succès!");
         statusLabel->setStyleSheet("color: green; font-weight: bold;");
-
-        for (int i = 0; i < 10; i++) {
-            threadTable->item(i, 2)->setText("✅ Terminé");
-            threadTable->item(i, 2)->setBackground(QColor(200, 255, 200));
-        }
+        segmentModel->setAllStates(SegmentModel::Done);
 
         QMessageBox::information(this, "✅ Succès", message);
     } else {
@@ -336,25 +440,13 @@ void MainWindow::onDownloadFinished(bool success, const QString &message) {
 }
 
 void MainWindow::onLogMessage(const QString &message) {
-    logOutput->append(message);
+    logModel->append(message);
 }
 
 void MainWindow::onThreadProgress(int threadId, int percentage) {
-    if (threadId >= 0 && threadId < 10) {
-        QProgressBar *bar = qobject_cast<QProgressBar*>(threadTable->cellWidget(threadId, 1));
-        if (bar) {
-            bar->setValue(percentage);
-        }
+    segmentModel->setProgress(threadId, percentage);
+}
 
-        QString status;
-        if (percentage == 0) {
-            status = "⏳ Démarrage...";
-        } else if (percentage == 100) {
-            status = "✅ Terminé";
-            threadTable->item(threadId, 2)->setBackground(QColor(200, 255, 200));
-        } else {
-            status = QString("📥 %1%").arg(percentage);
-        }
-        threadTable->item(threadId, 2)->setText(status);
-    }
+void MainWindow::onThreadCountChanged(int count) {
+    segmentModel->setCount(count);
 }
@@ -6,10 +6,14 @@
 #include <QPushButton>
 #include <QProgressBar>
 #include <QLabel>
-#include <QTextEdit>
-#include <QTableWidget>
+#include <QListView>
+#include <QTableView>
 #include <QGroupBox>
+#include <QSpinBox>
+#include <QCheckBox>
 #include "downloadmanager.h"
+#include "logmodel.h"
+#include "segmentmodel.h"
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
@@ -26,6 +30,7 @@ private slots:
     void onDownloadFinished(bool success, const QString &message);
     void onLogMessage(const QString &message);
     void onThreadProgress(int threadId, int percentage);
+    void onThreadCountChanged(int count);
 
 private:
     void setupUI();
@@ -33,6 +38,13 @@ private:
 
     QLineEdit *urlInput;
     QLineEdit *savePathInput;
+    QLineEdit *checksumInput;
+    QSpinBox *connectionsInput;
+    QSpinBox *minConnectionsInput;
+    QSpinBox *maxConnectionsInput;
+    QSpinBox *retriesInput;
+    QSpinBox *rateLimitInput;
+    QCheckBox *http2Input;
     QPushButton *downloadButton;
     QPushButton *pauseButton;
     QPushButton *cancelButton;
@@ -42,8 +54,11 @@ private:
     QLabel *speedLabel;
     QLabel *fileSizeLabel;
     QLabel *elapsedTimeLabel;
-    QTextEdit *logOutput;
-    QTableWidget *threadTable;
+    QListView *logView;
+    LogModel *logModel;
+    bool followLog;
+    QTableView *threadTable;
+    SegmentModel *segmentModel;
 
     DownloadManager *downloadManager;
     bool isPaused;
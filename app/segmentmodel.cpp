@@ -0,0 +1,152 @@
+#include "segmentmodel.h"
+#include <QColor>
+#include <QLinearGradient>
+#include <QPainter>
+#include <QTimer>
+
+// Progress reaches the view at most this often (10 Hz).
+static const int FlushIntervalMs = 100;
+
+SegmentModel::SegmentModel(QObject *parent)
+    : QAbstractTableModel(parent), dirtyFirst(-1), dirtyLast(-1) {
+    flushTimer = new QTimer(this);
+    flushTimer->setSingleShot(true);
+    flushTimer->setInterval(FlushIntervalMs);
+    connect(flushTimer, &QTimer::timeout, this, &SegmentModel::flush);
+}
+
+int SegmentModel::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : segments.size();
+}
+
+int SegmentModel::columnCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant SegmentModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || index.row() >= segments.size()) {
+        return QVariant();
+    }
+    const Segment &segment = segments[index.row()];
+
+    if (role == Qt::BackgroundRole && index.column() == StateColumn && segment.state == Done) {
+        return QColor(200, 255, 200);
+    }
+    if (role != Qt::DisplayRole) {
+        return QVariant();
+    }
+
+    switch (index.column()) {
+    case ThreadColumn:
+        return QString("Thread %1").arg(index.row());
+    case ProgressColumn:
+        return segment.percentage;
+    default:
+        break;
+    }
+    switch (segment.state) {
+    case Waiting:   return QString("⏳ En attente");
+    case Done:      return QString("✅ Terminé");
+    case Cancelled: return QString("✖ Annulé");
+    case Running:
+        break;
+    }
+    return segment.percentage == 0 ? QString("⏳ Démarrage...") : QString("📥 %1%").arg(segment.percentage);
+}
+
+QVariant SegmentModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+    switch (section) {
+    case ThreadColumn:   return QString("Thread");
+    case ProgressColumn: return QString("Progression");
+    case StateColumn:    return QString("État");
+    default:             return QVariant();
+    }
+}
+
+void SegmentModel::clear() {
+    beginResetModel();
+    segments.clear();
+    dirtyFirst = dirtyLast = -1;
+    flushTimer->stop();
+    endResetModel();
+}
+
+void SegmentModel::setCount(int count) {
+    if (count <= segments.size()) {
+        return;
+    }
+    beginInsertRows(QModelIndex(), segments.size(), count - 1);
+    segments.resize(count);
+    endInsertRows();
+}
+
+void SegmentModel::setProgress(int row, int percentage) {
+    if (row < 0 || row >= segments.size()) {
+        return;
+    }
+    Segment &segment = segments[row];
+    segment.percentage = percentage;
+    segment.state = percentage == 100 ? Done : Running;
+
+    dirtyFirst = dirtyFirst < 0 ? row : qMin(dirtyFirst, row);
+    dirtyLast = qMax(dirtyLast, row);
+    if (!flushTimer->isActive()) {
+        flushTimer->start();
+    }
+}
+
+void SegmentModel::setAllStates(State state) {
+    for (Segment &segment : segments) {
+        segment.state = state;
+    }
+    flushTimer->stop();
+    dirtyFirst = dirtyLast = -1;
+    if (!segments.isEmpty()) {
+        emit dataChanged(index(0, ProgressColumn), index(segments.size() - 1, StateColumn));
+    }
+}
+
+void SegmentModel::flush() {
+    if (dirtyFirst < 0) {
+        return;
+    }
+    emit dataChanged(index(dirtyFirst, ProgressColumn), index(dirtyLast, StateColumn));
+    dirtyFirst = dirtyLast = -1;
+}
+
+void ProgressDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const {
+    int percentage = qBound(0, index.data().toInt(), 100);
+    QRectF frame = QRectF(option.rect).adjusted(4, 3, -4, -3);
+
+    painter->save();
+    painter->setRenderHint(QPainter::Antialiasing);
+    painter->setPen(QPen(QColor("#ddd"), 1));
+    painter->setBrush(Qt::white);
+    painter->drawRoundedRect(frame, 4, 4);
+
+    if (percentage > 0) {
+        QRectF chunk = frame.adjusted(1.5, 1.5, -1.5, -1.5);
+        chunk.setWidth(chunk.width() * percentage / 100);
+        QLinearGradient gradient(chunk.topLeft(), chunk.topRight());
+        gradient.setColorAt(0, QColor("#4CAF50"));
+        gradient.setColorAt(1, QColor("#8BC34A"));
+        painter->setPen(Qt::NoPen);
+        painter->setBrush(gradient);
+        painter->drawRoundedRect(chunk, 3, 3);
+    }
+
+    QFont font = option.font;
+    font.setBold(true);
+    painter->setFont(font);
+    painter->setPen(option.palette.color(QPalette::Text));
+    painter->drawText(frame, Qt::AlignCenter, QString("%1%").arg(percentage));
+    painter->restore();
+}
+
+QSize ProgressDelegate::sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const {
+    Q_UNUSED(index);
+    return QSize(100, option.fontMetrics.height() + 10);
+}
@@ -0,0 +1,59 @@
+#ifndef SEGMENTMODEL_H
+#define SEGMENTMODEL_H
+
+#include <QAbstractTableModel>
+#include <QStyledItemDelegate>
+#include <QVector>
+
+class QTimer;
+
+// One row per worker of the download. Progress updates are only recorded;
+// the view hears about them in one dataChanged per flush, so hundreds of
+// segments cost the same as a few.
+class SegmentModel : public QAbstractTableModel {
+    Q_OBJECT
+
+public:
+    enum Column { ThreadColumn, ProgressColumn, StateColumn, ColumnCount };
+    enum State { Waiting, Running, Done, Cancelled };
+
+    explicit SegmentModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    void clear();
+    // Rows are only added: a retired worker keeps its row.
+    void setCount(int count);
+    void setProgress(int row, int percentage);
+    void setAllStates(State state);
+
+private:
+    void flush();
+
+    struct Segment {
+        int percentage = 0;
+        State state = Waiting;
+    };
+
+    QVector<Segment> segments;
+    int dirtyFirst;
+    int dirtyLast;
+    QTimer *flushTimer;
+};
+
+// Progress bar painted straight into the cell, instead of a QProgressBar
+// widget per row.
+class ProgressDelegate : public QStyledItemDelegate {
+    Q_OBJECT
+
+public:
+    using QStyledItemDelegate::QStyledItemDelegate;
+
+    void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+    QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+};
+
+#endif
@@ -0,0 +1,14 @@
+QT       = core network
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+TARGET = fastdoms-bench
+
+include(../core/core.pri)
+
+SOURCES += \
+    main.cpp \
+    testserver.cpp
+
+HEADERS += \
+    testserver.h
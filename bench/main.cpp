@@ -0,0 +1,296 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include "downloadmanager.h"
+#include "testserver.h"
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+struct RunConfig {
+    int connections = 0;
+    int retries = 5;
+    DownloadManager::Protocol protocol = DownloadManager::Http1;
+    Transport::Backend transport = Transport::QtNetwork;
+    int http2Connections = 1;
+    qint32 streamWindow = 0;
+    qint32 sessionWindow = 0;
+    QString traceDirectory;
+};
+
+struct RunResult {
+    bool success = false;
+    QString message;
+    qint64 bytes = 0;
+    double seconds = 0;
+    double cpuSeconds = 0;
+    qint64 peakRss = 0;
+    bool verified = false;
+};
+
+// Accepts plain byte counts or K/M/G suffixes (powers of 1024).
+static qint64 parseSize(QString text) {
+    text = text.trimmed().toUpper();
+    qint64 unit = 1;
+    if (text.endsWith('K')) unit = 1024;
+    else if (text.endsWith('M')) unit = 1024 * 1024;
+    else if (text.endsWith('G')) unit = 1024 * 1024 * 1024;
+    if (unit > 1) {
+        text.chop(1);
+    }
+    return text.toLongLong() * unit;
+}
+
+static double cpuTime() {
+#ifdef Q_OS_UNIX
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+#else
+    return 0;
+#endif
+}
+
+// Linux lets a process reset its peak RSS (VmHWM), so each run reports its own
+// peak; elsewhere the figure is the peak since start-up.
+static void resetPeakRss() {
+    QFile clearRefs("/proc/self/clear_refs");
+    if (clearRefs.open(QIODevice::WriteOnly)) {
+        clearRefs.write("5");
+    }
+}
+
+static qint64 peakRss() {
+    QFile status("/proc/self/status");
+    if (status.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        for (const QByteArray &line : status.readAll().split('\n')) {
+            if (line.startsWith("VmHWM:")) {
+                return line.mid(6).trimmed().split(' ').value(0).toLongLong() * 1024;
+            }
+        }
+    }
+#ifdef Q_OS_UNIX
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return qint64(usage.ru_maxrss) * 1024;
+#else
+    return 0;
+#endif
+}
+
+static bool verifyFile(const QString &path, qint64 size) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly) || file.size() != size) {
+        return false;
+    }
+    QByteArray expected(1024 * 1024, Qt::Uninitialized);
+    qint64 offset = 0;
+    while (offset < size) {
+        QByteArray actual = file.read(expected.size());
+        if (actual.isEmpty()) {
+            return false;
+        }
+        TestServer::fill(expected.data(), offset, actual.size());
+        if (memcmp(actual.constData(), expected.constData(), actual.size()) != 0) {
+            return false;
+        }
+        offset += actual.size();
+    }
+    return true;
+}
+
+static RunResult runOnce(const QString &url, const QString &savePath, qint64 size, const RunConfig &config, bool verify) {
+    QFile::remove(savePath);
+    QFile::remove(savePath + ".part");
+    QFile::remove(savePath + ".part.json");
+
+    RunResult result;
+    DownloadManager manager;
+    manager.setFixedConnections(config.connections);
+    manager.setMaxRetries(config.retries);
+    manager.setProtocol(config.protocol);
+    manager.setTransport(config.transport);
+    manager.setHttp2Connections(config.http2Connections);
+    manager.setHttp2Windows(config.streamWindow, config.sessionWindow);
+    if (!config.traceDirectory.isEmpty()) {
+        manager.setTraceFile(QDir(config.traceDirectory).filePath(QFileInfo(savePath).completeBaseName() + ".trace.json"));
+    }
+
+    QEventLoop loop;
+    QObject::connect(&manager, &DownloadManager::downloadFinished, &loop, [&](bool success, const QString &message) {
+        result.success = success;
+        result.message = message;
+        loop.quit();
+    });
+
+    resetPeakRss();
+    double cpuBefore = cpuTime();
+    QElapsedTimer timer;
+    timer.start();
+    manager.startDownload(url, savePath);
+    loop.exec();
+    result.seconds = timer.nsecsElapsed() / 1e9;
+    result.cpuSeconds = cpuTime() - cpuBefore;
+    result.peakRss = peakRss();
+
+    result.bytes = QFileInfo(savePath).size();
+    if (result.success && verify) {
+        result.verified = verifyFile(savePath, size);
+    }
+    QFile::remove(savePath);
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("fastdoms-bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Banc d'essai hors ligne: télécharge depuis un serveur HTTP local et mesure débit, durée, mémoire et CPU.\n"
+                                     "Le temps CPU inclut celui du serveur, qui tourne dans le même processus.\n"
+                                     "Le serveur local ne parle que HTTP/1.1: pour comparer avec HTTP/2, utiliser --url vers un serveur https.");
+    parser.addHelpOption();
+
+    QCommandLineOption sizesOption("sizes", "Tailles de fichier, séparées par des virgules (suffixes K, M, G).", "list", "16M,128M,512M");
+    QCommandLineOption connectionsOption("connections", "Nombres de connexions à tester (0 = automatique).", "list", "1,4,8,16,0");
+    QCommandLineOption repeatOption("repeat", "Répétitions de chaque combinaison.", "n", "1");
+    QCommandLineOption retriesOption("retries", "Tentatives par segment avant échec.", "n", "5");
+    QCommandLineOption directoryOption("dir", "Dossier des fichiers téléchargés (temporaire par défaut).", "dir");
+    QCommandLineOption rateOption("connection-rate", "Débit maximal par connexion côté serveur, en octets par seconde.", "bytes", "0");
+    QCommandLineOption latencyOption("latency", "Délai avant chaque réponse, en millisecondes.", "ms", "0");
+    QCommandLineOption stallAfterOption("stall-after", "Octets envoyés avant qu'une réponse se fige.", "bytes", "0");
+    QCommandLineOption stallOption("stall-ms", "Durée du blocage, en millisecondes.", "ms", "0");
+    QCommandLineOption resetAfterOption("reset-after", "Octets envoyés avant de couper la connexion.", "bytes", "0");
+    QCommandLineOption resetEveryOption("reset-every", "Ne coupe qu'une réponse sur N.", "n", "1");
+    QCommandLineOption noRangesOption("no-ranges", "Le serveur ignore les requêtes Range.");
+    QCommandLineOption noVerifyOption("no-verify", "Ne vérifie pas le contenu téléchargé.");
+    QCommandLineOption jsonOption("json", "Un objet JSON par mesure au lieu du tableau.");
+    QCommandLineOption urlOption("url", "Télécharge cette URL au lieu du serveur local (--sizes et la vérification sont ignorés).", "url");
+    QCommandLineOption protocolsOption("protocols", "Modes à comparer: http1 (une connexion par segment), http2 (flux multiplexés).", "list", "http1");
+    QCommandLineOption transportsOption("transports", "Moteurs HTTP à comparer: qt, curl (si compilé avec libcurl).", "list", "qt");
+    QCommandLineOption http2ConnectionsOption("http2-connections", "Connexions HTTP/2 par serveur en mode http2.", "n", "1");
+    QCommandLineOption streamWindowOption("stream-window", "Fenêtre de réception HTTP/2 par flux (0 = défaut de Qt).", "bytes", "0");
+    QCommandLineOption sessionWindowOption("session-window", "Fenêtre de réception HTTP/2 par connexion (0 = défaut de Qt).", "bytes", "0");
+    QCommandLineOption traceOption("trace", "Dossier où écrire une trace Chrome par mesure.", "dir");
+    parser.addOptions({sizesOption, connectionsOption, repeatOption, retriesOption, directoryOption, rateOption,
+                       latencyOption, stallAfterOption, stallOption, resetAfterOption, resetEveryOption,
+                       noRangesOption, noVerifyOption, jsonOption, urlOption, protocolsOption, transportsOption,
+                       http2ConnectionsOption, streamWindowOption, sessionWindowOption, traceOption});
+    parser.process(app);
+
+    TestServer::Behaviour behaviour;
+    behaviour.connectionRate = parseSize(parser.value(rateOption));
+    behaviour.latencyMs = parser.value(latencyOption).toInt();
+    behaviour.stallAfter = parseSize(parser.value(stallAfterOption));
+    behaviour.stallMs = parser.value(stallOption).toInt();
+    behaviour.resetAfter = parseSize(parser.value(resetAfterOption));
+    behaviour.resetEvery = parser.value(resetEveryOption).toInt();
+    behaviour.acceptRanges = !parser.isSet(noRangesOption);
+
+    TestServer server(behaviour);
+    if (!server.start()) {
+        fprintf(stderr, "Impossible de démarrer le serveur de test\n");
+        return 2;
+    }
+
+    QTemporaryDir temporary;
+    QString directory = parser.isSet(directoryOption) ? parser.value(directoryOption) : temporary.path();
+    QDir().mkpath(directory);
+
+    const bool json = parser.isSet(jsonOption);
+    const bool external = parser.isSet(urlOption);
+    const bool verify = !parser.isSet(noVerifyOption) && !external;
+    const int repeat = qMax(1, parser.value(repeatOption).toInt());
+
+    QList<DownloadManager::Protocol> protocols;
+    for (const QString &name : parser.value(protocolsOption).split(',', Qt::SkipEmptyParts)) {
+        if (name.trimmed() == "http1") {
+            protocols.append(DownloadManager::Http1);
+        } else if (name.trimmed() == "http2") {
+            protocols.append(DownloadManager::Http2);
+        } else {
+            fprintf(stderr, "Mode inconnu: %s (attendu: http1 ou http2)\n", qPrintable(name));
+            return 2;
+        }
+    }
+
+    QList<Transport::Backend> transports;
+    for (const QString &name : parser.value(transportsOption).split(',', Qt::SkipEmptyParts)) {
+        Transport::Backend backend;
+        if (!Transport::fromName(name.trimmed(), backend) || !Transport::isAvailable(backend)) {
+            fprintf(stderr, "Moteur indisponible: %s (attendu: qt ou curl)\n", qPrintable(name));
+            return 2;
+        }
+        transports.append(backend);
+    }
+
+    RunConfig config;
+    config.retries = parser.value(retriesOption).toInt();
+    config.http2Connections = qMax(1, parser.value(http2ConnectionsOption).toInt());
+    config.streamWindow = qint32(qMin<qint64>(parseSize(parser.value(streamWindowOption)), std::numeric_limits<qint32>::max()));
+    config.traceDirectory = parser.value(traceOption);
+    if (!config.traceDirectory.isEmpty()) {
+        QDir().mkpath(config.traceDirectory);
+    }
+    config.sessionWindow = qint32(qMin<qint64>(parseSize(parser.value(sessionWindowOption)), std::numeric_limits<qint32>::max()));
+
+    if (!json) {
+        printf("%10s %6s %6s %6s %4s %10s %9s %9s %10s %s\n", "taille", "mode", "moteur", "conn", "n°", "MB/s", "durée s", "CPU s", "RSS max", "résultat");
+    }
+
+    // An external URL has one size, whatever the server sends.
+    QStringList sizes = external ? QStringList{"-"} : parser.value(sizesOption).split(',', Qt::SkipEmptyParts);
+
+    bool allPassed = true;
+    for (const QString &sizeText : sizes) {
+        qint64 size = external ? -1 : parseSize(sizeText);
+        QString url = external ? parser.value(urlOption) : server.url(size);
+        for (DownloadManager::Protocol protocol : protocols) {
+            config.protocol = protocol;
+            QString mode = protocol == DownloadManager::Http2 ? "http2" : "http1";
+            for (Transport::Backend transport : transports) {
+                config.transport = transport;
+                QString engine = Transport::name(transport);
+                for (const QString &connectionText : parser.value(connectionsOption).split(',', Qt::SkipEmptyParts)) {
+                    config.connections = connectionText.toInt();
+                    for (int run = 1; run <= repeat; ++run) {
+                        QString savePath = QDir(directory).filePath(QString("bench-%1-%2-%3-%4-%5.bin").arg(size).arg(mode).arg(engine).arg(config.connections).arg(run));
+                        RunResult result = runOnce(url, savePath, size, config, verify);
+
+                        bool passed = result.success && (!verify || result.verified);
+                        allPassed = allPassed && passed;
+                        double mbps = result.seconds > 0 ? result.bytes / result.seconds / (1024 * 1024) : 0;
+                        QString outcome = !result.success ? result.message : (verify && !result.verified ? "contenu invalide" : "ok");
+                        QString sizeLabel = external ? QString("%1M").arg(result.bytes / (1024 * 1024)) : sizeText.trimmed();
+
+                        if (json) {
+                            QJsonObject row{{"size", external ? result.bytes : size}, {"protocol", mode}, {"transport", engine},
+                                            {"connections", config.connections}, {"run", run},
+                                            {"mbps", mbps}, {"seconds", result.seconds}, {"cpuSeconds", result.cpuSeconds},
+                                            {"peakRss", result.peakRss}, {"success", passed}, {"message", outcome}};
+                            printf("%s\n", QJsonDocument(row).toJson(QJsonDocument::Compact).constData());
+                        } else {
+                            printf("%10s %6s %6s %6s %4d %10.1f %9.2f %9.2f %8lldMB %s\n", qPrintable(sizeLabel), qPrintable(mode), qPrintable(engine),
+                                   config.connections > 0 ? qPrintable(QString::number(config.connections)) : "auto", run, mbps,
+                                   result.seconds, result.cpuSeconds, result.peakRss / (1024 * 1024), qPrintable(outcome));
+                        }
+                        fflush(stdout);
+                    }
+                }
+            }
+        }
+    }
+
+    return allPassed ? 0 : 1;
+}
@@ -0,0 +1,252 @@
+#include "testserver.h"
+#include <QHostAddress>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QThread>
+#include <QTimer>
+#include <cstring>
+
+static const qint64 ChunkSize = 64 * 1024;
+// Stop queuing body bytes while this much is still waiting in the socket.
+static const qint64 HighWater = 512 * 1024;
+static const int PaceIntervalMs = 5;
+
+TestServer::TestServer(const Behaviour &behaviour, QObject *parent)
+    : QObject(parent), config(behaviour), listenPort(0) {
+    thread = new QThread();
+    thread->setObjectName("FastDoms test server");
+    server = new QTcpServer();
+    server->moveToThread(thread);
+    connect(thread, &QThread::finished, server, &QObject::deleteLater);
+}
+
+TestServer::~TestServer() {
+    thread->quit();
+    thread->wait();
+    delete thread;
+}
+
+bool TestServer::start() {
+    thread->start();
+
+    bool listening = false;
+    QMetaObject::invokeMethod(server, [this, &listening]() {
+        connect(server, &QTcpServer::newConnection, server, [this]() {
+            while (QTcpSocket *socket = server->nextPendingConnection()) {
+                new TestConnection(socket, this);
+            }
+        });
+        listening = server->listen(QHostAddress::LocalHost, 0);
+        listenPort = server->serverPort();
+    }, Qt::BlockingQueuedConnection);
+    return listening;
+}
+
+quint16 TestServer::port() const {
+    return listenPort;
+}
+
+QString TestServer::url(qint64 size) const {
+    return QString("http://127.0.0.1:%1/bytes/%2").arg(listenPort).arg(size);
+}
+
+const TestServer::Behaviour &TestServer::behaviour() const {
+    return config;
+}
+
+bool TestServer::shouldReset() {
+    return config.resetAfter > 0 && resetCounter.fetchAndAddRelaxed(1) % qMax(1, config.resetEvery) == 0;
+}
+
+void TestServer::fill(char *buffer, qint64 offset, qint64 length) {
+    for (qint64 i = 0; i < length; ++i) {
+        quint64 position = quint64(offset + i);
+        quint64 word = (position / 8 + 1) * 0x9E3779B97F4A7C15ull;
+        buffer[i] = char(word >> (8 * (position % 8)));
+    }
+}
+
+TestConnection::TestConnection(QTcpSocket *socket, TestServer *server)
+    : QObject(socket), socket(socket), owner(server), responding(false), bodyOffset(0), bodyEnd(-1),
+      bodySent(0), stalled(false), resetThisResponse(false), tokens(0) {
+    paceTimer = new QTimer(this);
+    paceTimer->setInterval(PaceIntervalMs);
+    connect(paceTimer, &QTimer::timeout, this, &TestConnection::pump);
+    connect(socket, &QTcpSocket::readyRead, this, &TestConnection::onReadyRead);
+    connect(socket, &QTcpSocket::bytesWritten, this, &TestConnection::pump);
+    connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+}
+
+void TestConnection::onReadyRead() {
+    input.append(socket->readAll());
+    while (!responding) {
+        int end = input.indexOf("\r\n\r\n");
+        if (end < 0) {
+            return;
+        }
+        QByteArray head = input.left(end);
+        input.remove(0, end + 4);
+        handleRequest(head);
+    }
+}
+
+void TestConnection::handleRequest(const QByteArray &head) {
+    QList<QByteArray> lines = head.split('\n');
+    QList<QByteArray> requestLine = lines.takeFirst().trimmed().split(' ');
+    QByteArray method = requestLine.value(0);
+    QByteArray path = requestLine.value(1);
+
+    QByteArray range;
+    QByteArray ifRange;
+    for (const QByteArray &line : lines) {
+        int colon = line.indexOf(':');
+        QByteArray name = line.left(colon).trimmed().toLower();
+        QByteArray value = line.mid(colon + 1).trimmed();
+        if (name == "range") {
+            range = value;
+        } else if (name == "if-range") {
+            ifRange = value;
+        }
+    }
+
+    responding = true;
+    const TestServer::Behaviour &behaviour = owner->behaviour();
+
+    bool ok = false;
+    qint64 size = path.startsWith("/bytes/") ? path.mid(7).toLongLong(&ok) : 0;
+    if (!ok || (method != "GET" && method != "HEAD")) {
+        sendHead(404, "Not Found", {"Content-Length: 0"});
+        finishResponse();
+        return;
+    }
+
+    bodyOffset = 0;
+    bodyEnd = size - 1;
+    int status = 200;
+    QByteArray reason = "OK";
+
+    bool useRange = behaviour.acceptRanges && range.startsWith("bytes=") && (ifRange.isEmpty() || ifRange == behaviour.etag);
+    if (useRange) {
+        QList<QByteArray> bounds = range.mid(6).split('-');
+        qint64 first = bounds.value(0).toLongLong();
+        qint64 last = bounds.value(1).isEmpty() ? size - 1 : qMin(bounds.value(1).toLongLong(), size - 1);
+        if (bounds.value(0).isEmpty()) {
+            // Suffix range: the last N bytes.
+            first = qMax<qint64>(0, size - bounds.value(1).toLongLong());
+            last = size - 1;
+        }
+        if (first > last || first >= size) {
+            sendHead(416, "Range Not Satisfiable", {"Content-Length: 0", "Content-Range: bytes */" + QByteArray::number(size)});
+            finishResponse();
+            return;
+        }
+        bodyOffset = first;
+        bodyEnd = last;
+        status = 206;
+        reason = "Partial Content";
+    }
+
+    QList<QByteArray> headers;
+    headers << "Content-Length: " + QByteArray::number(bodyEnd - bodyOffset + 1)
+            << "ETag: " + behaviour.etag
+            << "Last-Modified: Thu, 01 Jan 2026 00:00:00 GMT";
+    if (behaviour.acceptRanges) {
+        headers << "Accept-Ranges: bytes";
+    }
+    if (status == 206) {
+        headers << "Content-Range: bytes " + QByteArray::number(bodyOffset) + "-" + QByteArray::number(bodyEnd) + "/" + QByteArray::number(size);
+    }
+
+    bool headOnly = method == "HEAD";
+    auto respond = [this, status, reason, headers, headOnly]() {
+        sendHead(status, reason, headers);
+        if (headOnly) {
+            finishResponse();
+            return;
+        }
+        bodySent = 0;
+        stalled = false;
+        resetThisResponse = owner->shouldReset();
+        tokens = 0;
+        clock.start();
+        paceTimer->start();
+        pump();
+    };
+
+    if (behaviour.latencyMs > 0) {
+        QTimer::singleShot(behaviour.latencyMs, this, respond);
+    } else {
+        respond();
+    }
+}
+
+void TestConnection::sendHead(int status, const QByteArray &reason, const QList<QByteArray> &headers) {
+    QByteArray head = "HTTP/1.1 " + QByteArray::number(status) + " " + reason + "\r\n";
+    for (const QByteArray &header : headers) {
+        head += header + "\r\n";
+    }
+    head += "Connection: keep-alive\r\n\r\n";
+    socket->write(head);
+}
+
+void TestConnection::pump() {
+    if (!responding || !paceTimer->isActive()) {
+        return;
+    }
+
+    const TestServer::Behaviour &behaviour = owner->behaviour();
+    if (behaviour.connectionRate > 0) {
+        double burst = qMax<double>(ChunkSize, behaviour.connectionRate / 20.0);
+        tokens = qMin(burst, tokens + clock.restart() * behaviour.connectionRate / 1000.0);
+    }
+
+    char buffer[ChunkSize];
+    while (bodyOffset <= bodyEnd && socket->bytesToWrite() < HighWater) {
+        if (behaviour.stallAfter > 0 && !stalled && bodySent >= behaviour.stallAfter) {
+            stalled = true;
+            paceTimer->stop();
+            QTimer::singleShot(behaviour.stallMs, this, [this]() {
+                clock.restart();
+                paceTimer->start();
+                pump();
+            });
+            return;
+        }
+
+        qint64 chunk = qMin(ChunkSize, bodyEnd - bodyOffset + 1);
+        if (behaviour.connectionRate > 0) {
+            chunk = qMin(chunk, qint64(tokens));
+            if (chunk <= 0) {
+                return;
+            }
+            tokens -= chunk;
+        }
+        if (resetThisResponse && bodySent + chunk >= behaviour.resetAfter) {
+            chunk = behaviour.resetAfter - bodySent;
+            TestServer::fill(buffer, bodyOffset, chunk);
+            socket->write(buffer, chunk);
+            socket->flush();
+            paceTimer->stop();
+            socket->abort();
+            return;
+        }
+
+        TestServer::fill(buffer, bodyOffset, chunk);
+        socket->write(buffer, chunk);
+        bodyOffset += chunk;
+        bodySent += chunk;
+    }
+
+    if (bodyOffset > bodyEnd) {
+        paceTimer->stop();
+        finishResponse();
+    }
+}
+
+void TestConnection::finishResponse() {
+    responding = false;
+    // Serve the next pipelined request once this response is queued.
+    if (!input.isEmpty()) {
+        QTimer::singleShot(0, this, &TestConnection::onReadyRead);
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef TESTSERVER_H
+#define TESTSERVER_H
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QObject>
+
+class QTcpServer;
+class QTcpSocket;
+class QThread;
+class QTimer;
+
+// Minimal HTTP/1.1 server for offline benchmarks. GET /bytes/<size> serves
+// <size> bytes of a deterministic pattern (see fill()), with HEAD, Range,
+// If-Range and keep-alive support, plus injectable faults. It runs on its
+// own thread so it does not compete with the engine's event loop.
+class TestServer : public QObject {
+    Q_OBJECT
+
+public:
+    struct Behaviour {
+        qint64 connectionRate = 0;  // bytes/s per connection, 0 = unlimited
+        int latencyMs = 0;          // delay before each response
+        qint64 stallAfter = 0;      // body bytes after which a response stalls once
+        int stallMs = 0;
+        qint64 resetAfter = 0;      // body bytes after which the connection is dropped
+        int resetEvery = 1;         // drop only every Nth response that reaches resetAfter
+        bool acceptRanges = true;
+        QByteArray etag = "\"fastdoms-test\"";
+    };
+
+    explicit TestServer(const Behaviour &behaviour, QObject *parent = nullptr);
+    ~TestServer();
+
+    bool start();
+    quint16 port() const;
+    QString url(qint64 size) const;
+
+    const Behaviour &behaviour() const;
+    bool shouldReset();
+
+    // Content of the served file: each 8-byte word depends on its index, so
+    // bytes written at the wrong offset are detected.
+    static void fill(char *buffer, qint64 offset, qint64 length);
+
+private:
+    Behaviour config;
+    QThread *thread;
+    QTcpServer *server;
+    quint16 listenPort;
+    QAtomicInt resetCounter;
+};
+
+class TestConnection : public QObject {
+    Q_OBJECT
+
+public:
+    TestConnection(QTcpSocket *socket, TestServer *server);
+
+private slots:
+    void onReadyRead();
+    void pump();
+
+private:
+    void handleRequest(const QByteArray &head);
+    void sendHead(int status, const QByteArray &reason, const QList<QByteArray> &headers);
+    void finishResponse();
+
+    QTcpSocket *socket;
+    TestServer *owner;
+    QTimer *paceTimer;
+    QByteArray input;
+    bool responding;
+
+    qint64 bodyOffset;
+    qint64 bodyEnd;
+    qint64 bodySent;
+    bool stalled;
+    bool resetThisResponse;
+    double tokens;
+    QElapsedTimer clock;
+};
+
+#endif
@@ -0,0 +1,326 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QRegularExpression>
+#include <QTextStream>
+#include <QUrl>
+#include <cstdio>
+#include <memory>
+#ifdef Q_OS_UNIX
+#include <csignal>
+#endif
+#include "contentcache.h"
+#include "downloadmanager.h"
+#include "downloadqueue.h"
+#include "metalink.h"
+#include "zsyncmanifest.h"
+
+struct Target {
+    QString url;
+    QString output;
+    QStringList mirrors;
+    Metalink metalink;
+};
+
+// Where events go: stderr when the file itself is streamed to stdout.
+static FILE *eventOutput = stdout;
+
+// One JSON object per line on stdout, so scripts can follow the run.
+static void printEvent(const QJsonObject &event) {
+    QByteArray line = QJsonDocument(event).toJson(QJsonDocument::Compact);
+    line.append('\n');
+    fwrite(line.constData(), 1, line.size(), eventOutput);
+    fflush(eventOutput);
+}
+
+static QString defaultOutput(const QString &url, const QString &directory, int index) {
+    QString name = QUrl(url).fileName();
+    if (name.isEmpty()) {
+        name = QString("download-%1").arg(index);
+    }
+    return QDir(directory).filePath(name);
+}
+
+// Small documents such as a .zsync manifest, fetched before the queue starts.
+static bool fetchDocument(const QUrl &url, QByteArray &document, QString *error) {
+    QNetworkAccessManager network;
+    QNetworkReply *reply = network.get(QNetworkRequest(url));
+    QEventLoop loop;
+    QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
+    loop.exec();
+    reply->deleteLater();
+    if (reply->error() != QNetworkReply::NoError) {
+        *error = reply->errorString();
+        return false;
+    }
+    document = reply->readAll();
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("fastdoms-cli");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Téléchargeur multi-connexion sans interface graphique.\n"
+                                     "La progression est écrite sur la sortie standard, un objet JSON par ligne.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("url", "URL(s) à télécharger.", "[url...]");
+
+    QCommandLineOption outputOption({"o", "output"}, "Chemin du fichier de destination (une seule URL).", "path");
+    QCommandLineOption inputOption({"i", "input-file"}, "Fichier avec une URL par ligne, suivie éventuellement du chemin de destination.", "file");
+    QCommandLineOption directoryOption({"d", "output-dir"}, "Dossier de destination quand aucun chemin n'est donné.", "dir", ".");
+    QCommandLineOption connectionsOption({"c", "connections"}, "Connexions par fichier (0 = ajustement automatique).", "n", "0");
+    QCommandLineOption minConnectionsOption("min-connections", "Minimum par fichier en mode automatique.", "n", "4");
+    QCommandLineOption maxConnectionsOption("max-connections", "Maximum par fichier en mode automatique.", "n", "32");
+    QCommandLineOption totalConnectionsOption("max-total-connections", "Connexions simultanées pour toute la file.", "n", "32");
+    QCommandLineOption hostConnectionsOption("max-host-connections", "Connexions simultanées par serveur.", "n", "16");
+    QCommandLineOption retriesOption("retries", "Tentatives par segment avant échec.", "n", "5");
+    QCommandLineOption rateOption("limit-rate", "Débit global maximal en octets par seconde (0 = illimité).", "bytes", "0");
+    QCommandLineOption checksumOption("checksum", "Empreinte attendue, vérifiée pendant le téléchargement (une seule URL).", "algo:hex");
+    QCommandLineOption mirrorOption("mirror", "Autre URL du même fichier, utilisée en parallèle (répétable, une seule URL).", "url");
+    QCommandLineOption metalinkOption("metalink", "Fichier Metalink (.meta4 ou .metalink) : miroirs et empreintes.", "file");
+    QCommandLineOption zsyncOption("zsync", "Manifeste .zsync (fichier ou URL) : seuls les blocs absents de l'ancienne version sont téléchargés (une seule URL).", "file|url");
+    QCommandLineOption seedOption("seed", "Ancienne version réutilisée avec --zsync (par défaut le fichier de destination).", "path");
+    QCommandLineOption endgameOption("endgame", "Octets restants sous lesquels les connexions libres doublent la fin des segments lents (0 = jamais).", "bytes", "8388608");
+    QCommandLineOption stragglerOption("straggler-ratio", "Un segment plus lent que cette fraction du débit médian est doublé (0 = jamais).", "ratio", "0.2");
+    QCommandLineOption http2Option("http2", "Segments en flux HTTP/2 multiplexés au lieu d'une connexion HTTP/1.1 chacun (https).");
+    QCommandLineOption http2ConnectionsOption("http2-connections", "Connexions HTTP/2 par serveur qui portent les flux.", "n", "1");
+    QCommandLineOption streamWindowOption("http2-stream-window", "Fenêtre de réception HTTP/2 par flux, en octets (0 = défaut de Qt).", "bytes", "0");
+    QCommandLineOption sessionWindowOption("http2-session-window", "Fenêtre de réception HTTP/2 par connexion, en octets (0 = défaut de Qt).", "bytes", "0");
+    QCommandLineOption preconnectOption("preconnect", "Ouvre les connexions (TLS compris) pendant la première requête, pour que les segments démarrent aussitôt la taille connue.");
+    QCommandLineOption transportOption("transport", "Moteur HTTP : qt (QNetworkAccessManager) ou curl (libcurl multi, si compilé avec).", "qt|curl", "qt");
+    QCommandLineOption extractOption("extract", "Dossier où décompresser (gzip, xz) et dépaqueter (tar) chaque fichier pendant son téléchargement.", "dir");
+    QCommandLineOption streamOption("stream", "Écrit aussi le fichier dans l'ordre, pendant le téléchargement, vers un tube nommé ou la sortie standard (-) ; les événements JSON passent alors sur la sortie d'erreur (une seule URL).", "path|-");
+    QCommandLineOption streamAheadOption("stream-ahead", "Avance maximale des segments sur ce que le lecteur de --stream a reçu, en octets (0 = illimitée).", "bytes", "67108864");
+    QCommandLineOption traceOption("trace", "Dossier où écrire une trace Chrome (<fichier>.trace.json) par téléchargement.", "dir");
+    QCommandLineOption cacheOption("cache", "Dossier de cache : un fichier déjà téléchargé et inchangé sur le serveur (304) y est recopié.", "dir");
+    QCommandLineOption cacheSizeOption("cache-size", "Taille maximale du cache en octets ; les fichiers les moins récemment utilisés sont supprimés.", "bytes", "10737418240");
+    QCommandLineOption cacheLinksOption("cache-hardlinks", "Liens physiques (en lecture seule) vers le cache quand les reflinks ne sont pas disponibles, au lieu de copies.");
+    QCommandLineOption quietOption({"q", "quiet"}, "N'écrit pas le journal d'activité sur la sortie d'erreur.");
+    parser.addOptions({outputOption, inputOption, directoryOption, connectionsOption, minConnectionsOption,
+                       maxConnectionsOption, totalConnectionsOption, hostConnectionsOption, retriesOption,
+                       rateOption, checksumOption, mirrorOption, metalinkOption, zsyncOption, seedOption, endgameOption, stragglerOption, http2Option,
+                       http2ConnectionsOption, streamWindowOption, sessionWindowOption, preconnectOption, transportOption, extractOption, streamOption, streamAheadOption,
+                       traceOption, cacheOption, cacheSizeOption,
+                       cacheLinksOption, quietOption});
+    parser.process(app);
+
+    Transport::Backend backend;
+    if (!Transport::fromName(parser.value(transportOption), backend) || !Transport::isAvailable(backend)) {
+        fprintf(stderr, "Moteur HTTP indisponible: %s\n", qPrintable(parser.value(transportOption)));
+        return 2;
+    }
+
+    QString directory = parser.value(directoryOption);
+    QList<Target> targets;
+
+    const QStringList urls = parser.positionalArguments();
+    // Without any other URL, the file a manifest describes is the target.
+    bool zsyncTarget = parser.isSet(zsyncOption) && urls.isEmpty() && !parser.isSet(metalinkOption);
+    if (parser.isSet(outputOption) && urls.size() + (parser.isSet(metalinkOption) || zsyncTarget ? 1 : 0) != 1) {
+        fprintf(stderr, "--output demande exactement une URL\n");
+        return 2;
+    }
+    for (const QString &url : urls) {
+        QString output = parser.isSet(outputOption) ? parser.value(outputOption) : defaultOutput(url, directory, targets.size());
+        targets.append({url, output, {}, {}});
+    }
+
+    if (parser.isSet(metalinkOption)) {
+        Metalink metalink;
+        QString error;
+        if (!Metalink::load(parser.value(metalinkOption), metalink, &error)) {
+            fprintf(stderr, "Metalink illisible %s: %s\n", qPrintable(parser.value(metalinkOption)), qPrintable(error));
+            return 2;
+        }
+        QString output = parser.isSet(outputOption) ? parser.value(outputOption)
+                       : !metalink.name.isEmpty() ? QDir(directory).filePath(QFileInfo(metalink.name).fileName())
+                       : defaultOutput(metalink.urls.first(), directory, targets.size());
+        targets.append({metalink.urls.first(), output, metalink.urls.mid(1), metalink});
+    }
+
+    ZsyncManifest zsync;
+    if (parser.isSet(zsyncOption)) {
+        QString location = parser.value(zsyncOption);
+        QUrl manifestUrl(location);
+        bool remote = manifestUrl.scheme() == "http" || manifestUrl.scheme() == "https";
+        QByteArray document;
+        QString error;
+        bool loaded = remote ? fetchDocument(manifestUrl, document, &error) && ZsyncManifest::parse(document, zsync, &error)
+                             : ZsyncManifest::load(location, zsync, &error);
+        if (!loaded) {
+            fprintf(stderr, "Manifeste zsync illisible %s: %s\n", qPrintable(location), qPrintable(error));
+            return 2;
+        }
+        if (zsyncTarget) {
+            // Its URL is relative to the manifest's own, usually.
+            QUrl url = remote ? manifestUrl.resolved(QUrl(zsync.url)) : QUrl(zsync.url);
+            if (zsync.url.isEmpty() || url.isRelative()) {
+                fprintf(stderr, "Le manifeste zsync ne donne pas d'URL absolue: indiquez l'URL du fichier\n");
+                return 2;
+            }
+            QString output = parser.isSet(outputOption) ? parser.value(outputOption)
+                           : !zsync.name.isEmpty() ? QDir(directory).filePath(QFileInfo(zsync.name).fileName())
+                           : defaultOutput(url.toString(), directory, targets.size());
+            targets.append({url.toString(), output, {}, {}});
+        }
+        if (targets.size() != 1) {
+            fprintf(stderr, "--zsync demande exactement une URL\n");
+            return 2;
+        }
+    }
+
+    if (parser.isSet(mirrorOption)) {
+        if (targets.size() != 1) {
+            fprintf(stderr, "--mirror demande exactement une URL\n");
+            return 2;
+        }
+        targets.first().mirrors += parser.values(mirrorOption);
+    }
+
+    if (parser.isSet(streamOption)) {
+        if (parser.isSet(inputOption) || targets.size() != 1) {
+            fprintf(stderr, "--stream demande exactement une URL\n");
+            return 2;
+        }
+        if (parser.value(streamOption) == "-") {
+            eventOutput = stderr;
+        }
+#ifdef Q_OS_UNIX
+        // A reader that goes away is reported as a write error instead.
+        signal(SIGPIPE, SIG_IGN);
+#endif
+    }
+
+    if (parser.isSet(inputOption)) {
+        QFile list(parser.value(inputOption));
+        if (!list.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            fprintf(stderr, "Impossible de lire %s: %s\n", qPrintable(list.fileName()), qPrintable(list.errorString()));
+            return 2;
+        }
+        QTextStream in(&list);
+        while (!in.atEnd()) {
+            QString line = in.readLine().trimmed();
+            if (line.isEmpty() || line.startsWith('#')) {
+                continue;
+            }
+            QStringList fields = line.split(QRegularExpression("\\s+"));
+            QString output = fields.size() > 1 ? fields.mid(1).join(' ') : defaultOutput(fields[0], directory, targets.size());
+            targets.append({fields[0], output, {}, {}});
+        }
+    }
+
+    if (targets.isEmpty()) {
+        parser.showHelp(2);
+    }
+
+    IntegrityVerifier::Algorithm algorithm = IntegrityVerifier::NoAlgorithm;
+    QByteArray digest;
+    if (parser.isSet(checksumOption)) {
+        if (targets.size() != 1) {
+            fprintf(stderr, "--checksum demande exactement une URL\n");
+            return 2;
+        }
+        if (!IntegrityVerifier::parseDigest(parser.value(checksumOption), algorithm, digest)) {
+            fprintf(stderr, "Empreinte invalide: %s (attendu: sha256:<hex>, sha512, sha1, md5 ou crc32c)\n",
+                    qPrintable(parser.value(checksumOption)));
+            return 2;
+        }
+    }
+
+    DownloadManager::setGlobalRateLimit(parser.value(rateOption).toLongLong());
+
+    // Outlives the queue: managers finish adding files to it when destroyed.
+    std::unique_ptr<ContentCache> cache;
+    if (parser.isSet(cacheOption)) {
+        cache = std::make_unique<ContentCache>(parser.value(cacheOption), parser.value(cacheSizeOption).toLongLong());
+        cache->setHardLinks(parser.isSet(cacheLinksOption));
+    }
+
+    DownloadQueue queue;
+    queue.setMaxConnections(parser.value(totalConnectionsOption).toInt());
+    queue.setMaxConnectionsPerHost(parser.value(hostConnectionsOption).toInt());
+
+    bool quiet = parser.isSet(quietOption);
+    int succeeded = 0;
+    int failed = 0;
+    QHash<int, Target> jobs;
+
+    for (const Target &target : targets) {
+        int jobId = queue.addJob(target.url, target.output);
+        jobs.insert(jobId, target);
+        DownloadManager *manager = queue.manager(jobId);
+        manager->setFixedConnections(parser.value(connectionsOption).toInt());
+        manager->setConnectionLimits(parser.value(minConnectionsOption).toInt(), parser.value(maxConnectionsOption).toInt());
+        manager->setMaxRetries(parser.value(retriesOption).toInt());
+        manager->setEndgame(parser.value(endgameOption).toLongLong(), parser.value(stragglerOption).toDouble());
+        manager->setProtocol(parser.isSet(http2Option) ? DownloadManager::Http2 : DownloadManager::Http1);
+        manager->setHttp2Connections(parser.value(http2ConnectionsOption).toInt());
+        manager->setHttp2Windows(parser.value(streamWindowOption).toInt(), parser.value(sessionWindowOption).toInt());
+        manager->setPreconnect(parser.isSet(preconnectOption));
+        manager->setTransport(backend);
+        manager->setExtraction(parser.value(extractOption));
+        manager->setStreamOutput(parser.value(streamOption), parser.value(streamAheadOption).toLongLong());
+        if (parser.isSet(traceOption)) {
+            QDir().mkpath(parser.value(traceOption));
+            manager->setTraceFile(QDir(parser.value(traceOption)).filePath(QFileInfo(target.output).fileName() + ".trace.json"));
+        }
+        manager->setCache(cache.get());
+        manager->setMirrors(target.mirrors);
+        manager->setPieceDigests(target.metalink.pieceAlgorithm, target.metalink.pieceLength, target.metalink.pieces);
+        if (parser.isSet(checksumOption)) {
+            manager->setExpectedDigest(algorithm, digest);
+        } else if (target.metalink.hash.isEmpty() && !zsync.sha1.isEmpty()) {
+            manager->setExpectedDigest(IntegrityVerifier::Sha1, zsync.sha1);
+        } else {
+            manager->setExpectedDigest(target.metalink.hashAlgorithm, target.metalink.hash);
+        }
+        if (zsync.isValid()) {
+            manager->setDelta(zsync, parser.isSet(seedOption) ? parser.value(seedOption) : target.output);
+        }
+
+        QObject::connect(manager, &DownloadManager::traceWritten, &app,
+                         [jobId](const QString &path, const QJsonObject &summary) {
+            printEvent({{"event", "trace"}, {"job", jobId}, {"path", path}, {"summary", summary}});
+        });
+        QObject::connect(manager, &DownloadManager::transferStats, &app,
+                         [jobId](qint64 received, qint64 total, qint64 bytesPerSecond) {
+            printEvent({{"event", "progress"}, {"job", jobId}, {"received", received},
+                        {"total", total}, {"bytesPerSecond", bytesPerSecond}});
+        });
+    }
+
+    QObject::connect(&queue, &DownloadQueue::jobStarted, &app, [&jobs](int jobId) {
+        const Target &target = jobs[jobId];
+        printEvent({{"event", "start"}, {"job", jobId}, {"url", target.url}, {"output", target.output}});
+    });
+    QObject::connect(&queue, &DownloadQueue::logMessage, &app, [quiet](int jobId, const QString &message) {
+        if (!quiet) {
+            fprintf(stderr, "[%d] %s\n", jobId, qPrintable(message));
+        }
+    });
+    QObject::connect(&queue, &DownloadQueue::jobFinished, &app,
+                     [&succeeded, &failed](int jobId, bool success, const QString &message) {
+        if (success) {
+            succeeded++;
+        } else {
+            failed++;
+        }
+        printEvent({{"event", "finished"}, {"job", jobId}, {"success", success}, {"message", message}});
+    });
+    QObject::connect(&queue, &DownloadQueue::allFinished, &app, [&app, &succeeded, &failed]() {
+        printEvent({{"event", "done"}, {"succeeded", succeeded}, {"failed", failed}});
+        app.exit(failed > 0 ? 1 : 0);
+    });
+
+    return app.exec();
+}
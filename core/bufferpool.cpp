@@ -0,0 +1,32 @@
+#include "bufferpool.h"
+#include <QMutexLocker>
+
+BufferPool::BufferPool(int blockCount, int blockSize)
+    : storage(qsizetype(blockCount) * blockSize, Qt::Uninitialized), available(blockCount), size(blockSize) {
+    freeBlocks.reserve(blockCount);
+    for (int i = 0; i < blockCount; ++i) {
+        freeBlocks.append(storage.data() + qsizetype(i) * blockSize);
+    }
+}
+
+char *BufferPool::acquire() {
+    available.acquire();
+    QMutexLocker locker(&mutex);
+    return freeBlocks.takeLast();
+}
+
+void BufferPool::release(char *block) {
+    {
+        QMutexLocker locker(&mutex);
+        freeBlocks.append(block);
+    }
+    available.release();
+}
+
+int BufferPool::blockSize() const {
+    return size;
+}
+
+qint64 BufferPool::capacity() const {
+    return storage.size();
+}
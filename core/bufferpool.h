@@ -0,0 +1,29 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <QByteArray>
+#include <QMutex>
+#include <QSemaphore>
+#include <QVector>
+
+// Fixed set of read buffers shared by all segments. The pool is allocated
+// once, so memory use does not grow with the size of the file.
+class BufferPool {
+public:
+    BufferPool(int blockCount, int blockSize);
+
+    char *acquire();
+    void release(char *block);
+
+    int blockSize() const;
+    qint64 capacity() const;
+
+private:
+    QByteArray storage;
+    QVector<char*> freeBlocks;
+    QSemaphore available;
+    QMutex mutex;
+    int size;
+};
+
+#endif
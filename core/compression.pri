@@ -0,0 +1,11 @@
+# zlib and liblzma, when pkg-config finds them, let StreamExtractor decode
+# gzip and xz. Included by the library and by everything linking it.
+CONFIG += link_pkgconfig
+packagesExist(zlib) {
+    PKGCONFIG += zlib
+    DEFINES += FASTDOMS_HAVE_ZLIB
+}
+packagesExist(liblzma) {
+    PKGCONFIG += liblzma
+    DEFINES += FASTDOMS_HAVE_LZMA
+}
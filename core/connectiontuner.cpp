@@ -0,0 +1,70 @@
+#include "connectiontuner.h"
+
+// Seconds of throughput averaged before each decision, long enough for new
+// connections to get past TCP slow start.
+static const int WindowSeconds = 3;
+// Added connections must bring at least this much extra throughput to stay.
+static const double GainThreshold = 1.10;
+
+ConnectionTuner::ConnectionTuner() : minConnections(4), maxConnections(32) {
+    reset();
+}
+
+void ConnectionTuner::setLimits(int minimum, int maximum) {
+    minConnections = qMax(1, minimum);
+    maxConnections = qMax(minConnections, maximum);
+}
+
+int ConnectionTuner::minimum() const {
+    return minConnections;
+}
+
+int ConnectionTuner::maximum() const {
+    return maxConnections;
+}
+
+void ConnectionTuner::reset() {
+    ticks = 0;
+    windowBytes = 0;
+    baseline = 0;
+    lastStep = 0;
+    errors = 0;
+    settled = false;
+}
+
+void ConnectionTuner::recordError() {
+    errors++;
+}
+
+int ConnectionTuner::sample(qint64 bytesPerSecond, int current) {
+    windowBytes += bytesPerSecond;
+    if (++ticks < WindowSeconds) {
+        return current;
+    }
+
+    qint64 throughput = windowBytes / ticks;
+    ticks = 0;
+    windowBytes = 0;
+
+    int target = current;
+    if (errors > 0) {
+        // Resets or refusals: the server or a middlebox is limiting us.
+        target = current - qMax(1, current / 4);
+        settled = true;
+    } else if (lastStep > 0 && throughput < baseline * GainThreshold) {
+        // The connections added last time did not pay for themselves.
+        target = current - lastStep;
+        settled = true;
+    } else if (!settled) {
+        target = current + qMax(1, current / 2);
+    } else if (throughput < baseline * 3 / 4) {
+        // Conditions changed a lot since we settled: probe again.
+        settled = false;
+    }
+
+    errors = 0;
+    target = qBound(minConnections, target, maxConnections);
+    lastStep = (target > current) ? target - current : 0;
+    baseline = throughput;
+    return target;
+}
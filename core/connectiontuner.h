@@ -0,0 +1,35 @@
+#ifndef CONNECTIONTUNER_H
+#define CONNECTIONTUNER_H
+
+#include <QtGlobal>
+
+// Hill-climbing on the number of connections: keep adding while the aggregate
+// throughput rises, undo the last step when it stops paying off, and back off
+// when the server starts failing requests.
+class ConnectionTuner {
+public:
+    ConnectionTuner();
+
+    void setLimits(int minimum, int maximum);
+    int minimum() const;
+    int maximum() const;
+
+    void reset();
+    void recordError();
+
+    // Fed once per second with the aggregate rate; returns the connection
+    // count to run with from now on.
+    int sample(qint64 bytesPerSecond, int current);
+
+private:
+    int minConnections;
+    int maxConnections;
+    int ticks;
+    qint64 windowBytes;
+    qint64 baseline;
+    int lastStep;
+    int errors;
+    bool settled;
+};
+
+#endif
@@ -0,0 +1,275 @@
+#include "contentcache.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QLockFile>
+#include <QMutexLocker>
+#include <QRandomGenerator>
+#include <QSaveFile>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+// Cached files are shared, so nobody should write to them through a hard link.
+static const QFile::Permissions CachedPermissions = QFile::ReadOwner | QFile::ReadGroup | QFile::ReadOther;
+static const QFile::Permissions CopyPermissions = CachedPermissions | QFile::WriteOwner;
+
+// Copy-on-write clone: instant and takes no space until either copy changes.
+static bool reflink(const QString &source, const QString &destination) {
+#if defined(Q_OS_LINUX) && defined(FICLONE)
+    int in = ::open(QFile::encodeName(source).constData(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        return false;
+    }
+    int out = ::open(QFile::encodeName(destination).constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    bool cloned = out >= 0 && ::ioctl(out, FICLONE, in) == 0;
+    if (out >= 0) {
+        ::close(out);
+    }
+    ::close(in);
+    if (!cloned) {
+        QFile::remove(destination);
+    }
+    return cloned;
+#else
+    Q_UNUSED(source);
+    Q_UNUSED(destination);
+    return false;
+#endif
+}
+
+ContentCache::ContentCache(const QString &directory, qint64 maxBytes)
+    : root(directory), limit(qMax<qint64>(0, maxBytes)), hardLinks(false) {
+    QDir().mkpath(QDir(root).filePath("objects"));
+}
+
+QString ContentCache::directory() const {
+    return root;
+}
+
+qint64 ContentCache::maxSize() const {
+    return limit;
+}
+
+void ContentCache::setHardLinks(bool enabled) {
+    hardLinks = enabled;
+}
+
+bool ContentCache::lookup(const QString &url, Entry &entry) {
+    QMutexLocker locker(&mutex);
+    QLockFile lock(QDir(root).filePath("index.lock"));
+    lock.lock();
+
+    QJsonObject index = loadIndex();
+    QJsonObject item = index.value("urls").toObject().value(url).toObject();
+    QByteArray digest = item.value("digest").toString().toLatin1();
+    QJsonObject object = index.value("objects").toObject().value(QString::fromLatin1(digest)).toObject();
+    if (digest.isEmpty() || object.isEmpty() || !QFile::exists(objectPath(digest))) {
+        return false;
+    }
+    entry.validator = item.value("validator").toString().toUtf8();
+    entry.digest = digest;
+    entry.size = object.value("size").toInteger();
+    return true;
+}
+
+bool ContentCache::contains(const QByteArray &digest) {
+    QMutexLocker locker(&mutex);
+    QLockFile lock(QDir(root).filePath("index.lock"));
+    lock.lock();
+
+    return loadIndex().value("objects").toObject().contains(QString::fromLatin1(digest))
+           && QFile::exists(objectPath(digest));
+}
+
+bool ContentCache::store(const QString &url, const QByteArray &validator, const QString &path,
+                         const QByteArray &digest, QString *error) {
+    qint64 size = QFileInfo(path).size();
+    if (size > limit) {
+        if (error) {
+            *error = "fichier plus grand que le cache";
+        }
+        return false;
+    }
+
+    QByteArray hex = digest;
+    if (hex.isEmpty()) {
+        QFile file(path);
+        QCryptographicHash hash(QCryptographicHash::Sha256);
+        if (!file.open(QIODevice::ReadOnly) || !hash.addData(&file)) {
+            if (error) {
+                *error = file.errorString();
+            }
+            return false;
+        }
+        hex = hash.result().toHex();
+    }
+
+    // Same content already there, maybe from another URL: nothing to copy.
+    // Otherwise it appears under its final name in one rename.
+    QString object = objectPath(hex);
+    if (!QFile::exists(object)) {
+        QString temporary = object + QString(".%1.tmp").arg(QRandomGenerator::global()->generate(), 0, 16);
+        if (!place(path, temporary, false, nullptr, error)) {
+            return false;
+        }
+        QFile::setPermissions(temporary, CachedPermissions);
+        if (!QFile::rename(temporary, object)) {
+            QFile::remove(temporary);
+            if (!QFile::exists(object)) {
+                if (error) {
+                    *error = "impossible d'ajouter le fichier au cache";
+                }
+                return false;
+            }
+        }
+    }
+
+    QMutexLocker locker(&mutex);
+    QLockFile lock(QDir(root).filePath("index.lock"));
+    lock.lock();
+
+    QJsonObject index = loadIndex();
+    QJsonObject urls = index.value("urls").toObject();
+    urls.insert(url, QJsonObject{{"validator", QString::fromUtf8(validator)}, {"digest", QString::fromLatin1(hex)}});
+    QJsonObject objects = index.value("objects").toObject();
+    objects.insert(QString::fromLatin1(hex), QJsonObject{{"size", size}, {"used", QDateTime::currentMSecsSinceEpoch()}});
+    index.insert("urls", urls);
+    index.insert("objects", objects);
+    evict(index);
+    if (!saveIndex(index)) {
+        if (error) {
+            *error = "impossible d'écrire l'index du cache";
+        }
+        return false;
+    }
+    return true;
+}
+
+bool ContentCache::materialize(const QByteArray &digest, const QString &destination, QString *error) {
+    // Copied outside the lock: another process evicting the file meanwhile
+    // only makes this fail, and the caller downloads it instead.
+    QString object = objectPath(digest);
+    QString temporary = destination + ".cache";
+    bool hardLinked = false;
+    if (!QFile::exists(object) || !place(object, temporary, hardLinks, &hardLinked, error)) {
+        if (error && error->isEmpty()) {
+            *error = "absent du cache";
+        }
+        return false;
+    }
+    if (!hardLinked) {
+        QFile::setPermissions(temporary, CopyPermissions);
+    }
+    QFile::remove(destination);
+    if (!QFile::rename(temporary, destination)) {
+        QFile::remove(temporary);
+        if (error) {
+            *error = "impossible d'écrire " + destination;
+        }
+        return false;
+    }
+
+    QMutexLocker locker(&mutex);
+    QLockFile lock(QDir(root).filePath("index.lock"));
+    lock.lock();
+
+    QJsonObject index = loadIndex();
+    QJsonObject objects = index.value("objects").toObject();
+    QJsonObject entry = objects.value(QString::fromLatin1(digest)).toObject();
+    if (!entry.isEmpty()) {
+        entry.insert("used", QDateTime::currentMSecsSinceEpoch());
+        objects.insert(QString::fromLatin1(digest), entry);
+        index.insert("objects", objects);
+        saveIndex(index);
+    }
+    return true;
+}
+
+QJsonObject ContentCache::loadIndex() const {
+    QFile file(QDir(root).filePath("index.json"));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QJsonObject();
+    }
+    return QJsonDocument::fromJson(file.readAll()).object();
+}
+
+bool ContentCache::saveIndex(const QJsonObject &index) const {
+    QSaveFile file(QDir(root).filePath("index.json"));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(QJsonDocument(index).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
+
+void ContentCache::evict(QJsonObject &index) const {
+    QJsonObject objects = index.value("objects").toObject();
+    QJsonObject urls = index.value("urls").toObject();
+
+    qint64 total = 0;
+    for (auto it = objects.constBegin(); it != objects.constEnd(); ++it) {
+        total += it.value().toObject().value("size").toInteger();
+    }
+
+    while (total > limit && !objects.isEmpty()) {
+        auto oldest = objects.constBegin();
+        for (auto it = objects.constBegin(); it != objects.constEnd(); ++it) {
+            if (it.value().toObject().value("used").toInteger() < oldest.value().toObject().value("used").toInteger()) {
+                oldest = it;
+            }
+        }
+        QString digest = oldest.key();
+        total -= oldest.value().toObject().value("size").toInteger();
+        objects.remove(digest);
+        QFile::remove(objectPath(digest.toLatin1()));
+
+        for (const QString &url : urls.keys()) {
+            if (urls.value(url).toObject().value("digest").toString() == digest) {
+                urls.remove(url);
+            }
+        }
+    }
+
+    index.insert("objects", objects);
+    index.insert("urls", urls);
+}
+
+QString ContentCache::objectPath(const QByteArray &digest) const {
+    return QDir(root).filePath("objects/" + QString::fromLatin1(digest));
+}
+
+bool ContentCache::place(const QString &source, const QString &destination, bool allowHardLink,
+                         bool *hardLinked, QString *error) const {
+    QFile::remove(destination);
+    if (reflink(source, destination)) {
+        return true;
+    }
+#ifdef Q_OS_UNIX
+    if (allowHardLink && ::link(QFile::encodeName(source).constData(), QFile::encodeName(destination).constData()) == 0) {
+        if (hardLinked) {
+            *hardLinked = true;
+        }
+        return true;
+    }
+#else
+    Q_UNUSED(allowHardLink);
+#endif
+    QFile file(source);
+    if (!file.copy(destination)) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,58 @@
+#ifndef CONTENTCACHE_H
+#define CONTENTCACHE_H
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QMutex>
+#include <QString>
+
+// Finished downloads kept on disk, so fetching the same file again costs one
+// conditional request. Each content is stored once under objects/, named by
+// its SHA-256, whatever URL it came from; index.json maps every URL to the
+// validator (strong ETag or Last-Modified) and digest it was stored with.
+// Least recently used contents are evicted beyond the size limit.
+// Safe to share between threads, and between processes using the same directory.
+class ContentCache {
+public:
+    struct Entry {
+        QByteArray validator;
+        QByteArray digest;      // SHA-256, hex
+        qint64 size = -1;
+    };
+
+    ContentCache(const QString &directory, qint64 maxBytes);
+
+    QString directory() const;
+    qint64 maxSize() const;
+    // Copies taken out of the cache are reflinks when the filesystem can,
+    // otherwise plain copies. With hard links allowed, a hard link comes
+    // before the copy: it shares the cached file, which is read-only.
+    void setHardLinks(bool enabled);
+
+    // The content last stored for url, if it is still there.
+    bool lookup(const QString &url, Entry &entry);
+    bool contains(const QByteArray &digest);
+
+    // Blocking. Adds the file at path under url, hashing it unless its
+    // SHA-256 (hex) is given, then evicts down to the size limit.
+    bool store(const QString &url, const QByteArray &validator, const QString &path,
+               const QByteArray &digest = QByteArray(), QString *error = nullptr);
+    // Blocking. Replaces destination with the content and marks it used.
+    bool materialize(const QByteArray &digest, const QString &destination, QString *error = nullptr);
+
+private:
+    QJsonObject loadIndex() const;
+    bool saveIndex(const QJsonObject &index) const;
+    void evict(QJsonObject &index) const;
+    QString objectPath(const QByteArray &digest) const;
+    // Reflink, else hard link if allowed, else copy.
+    bool place(const QString &source, const QString &destination, bool allowHardLink,
+               bool *hardLinked, QString *error) const;
+
+    QString root;
+    qint64 limit;
+    bool hardLinks;
+    QMutex mutex;
+};
+
+#endif
@@ -0,0 +1,16 @@
+# Included by every target that links the download engine.
+QT += core network
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+CORE_OUT = $$shadowed($$PWD)
+win32:CONFIG(release, debug|release): CORE_OUT = $$CORE_OUT/release
+else:win32:CONFIG(debug, debug|release): CORE_OUT = $$CORE_OUT/debug
+
+LIBS += -L$$CORE_OUT -lfastdoms-core
+include(curl.pri)
+include(compression.pri)
+
+win32:!win32-g++: PRE_TARGETDEPS += $$CORE_OUT/fastdoms-core.lib
+else: PRE_TARGETDEPS += $$CORE_OUT/libfastdoms-core.a
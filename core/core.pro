@@ -0,0 +1,63 @@
+QT       = core network
+
+TEMPLATE = lib
+CONFIG += staticlib c++17
+TARGET = fastdoms-core
+
+include(curl.pri)
+include(compression.pri)
+
+# You can make your code fail to compile if it uses deprecated APIs.
+# In order to do so, uncomment the following line.
+#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
+
+SOURCES += \
+    bufferpool.cpp \
+    connectiontuner.cpp \
+    contentcache.cpp \
+    crc32c.cpp \
+    downloadjournal.cpp \
+    downloadmanager.cpp \
+    downloadqueue.cpp \
+    integrityverifier.cpp \
+    iothreadpool.cpp \
+    metalink.cpp \
+    outputfile.cpp \
+    prefixstreamer.cpp \
+    qttransport.cpp \
+    rangeset.cpp \
+    ratelimiter.cpp \
+    segmentscheduler.cpp \
+    streamextractor.cpp \
+    tlssessioncache.cpp \
+    tracerecorder.cpp \
+    transport.cpp \
+    zsyncmanifest.cpp
+
+HEADERS += \
+    bufferpool.h \
+    connectiontuner.h \
+    contentcache.h \
+    crc32c.h \
+    downloadjournal.h \
+    downloadmanager.h \
+    downloadqueue.h \
+    integrityverifier.h \
+    iothreadpool.h \
+    metalink.h \
+    outputfile.h \
+    prefixstreamer.h \
+    qttransport.h \
+    rangeset.h \
+    ratelimiter.h \
+    segmentscheduler.h \
+    streamextractor.h \
+    tlssessioncache.h \
+    tracerecorder.h \
+    transport.h \
+    zsyncmanifest.h
+
+contains(DEFINES, FASTDOMS_HAVE_CURL) {
+    SOURCES += curltransport.cpp
+    HEADERS += curltransport.h
+}
@@ -0,0 +1,148 @@
+#include "crc32c.h"
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define CRC32C_X86
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define CRC32C_ARM
+#endif
+
+// Reversed Castagnoli polynomial.
+static const quint32 Polynomial = 0x82F63B78;
+
+static quint32 crc32cSoftware(quint32 crc, const uchar *data, qint64 length) {
+    static const struct Table {
+        quint32 entries[256];
+        Table() {
+            for (quint32 i = 0; i < 256; ++i) {
+                quint32 value = i;
+                for (int bit = 0; bit < 8; ++bit) {
+                    value = (value & 1) ? (value >> 1) ^ Polynomial : value >> 1;
+                }
+                entries[i] = value;
+            }
+        }
+    } table;
+
+    while (length-- > 0) {
+        crc = table.entries[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if defined(CRC32C_X86)
+__attribute__((target("sse4.2")))
+static quint32 crc32cHardware(quint32 crc, const uchar *data, qint64 length) {
+    quint64 value = crc;
+    while (length >= 8) {
+        quint64 word;
+        memcpy(&word, data, 8);
+        value = _mm_crc32_u64(value, word);
+        data += 8;
+        length -= 8;
+    }
+    crc = quint32(value);
+    while (length-- > 0) {
+        crc = _mm_crc32_u8(crc, *data++);
+    }
+    return crc;
+}
+
+static bool hasHardwareCrc() {
+    return __builtin_cpu_supports("sse4.2");
+}
+#elif defined(CRC32C_ARM)
+static quint32 crc32cHardware(quint32 crc, const uchar *data, qint64 length) {
+    while (length >= 8) {
+        quint64 word;
+        memcpy(&word, data, 8);
+        crc = __crc32cd(crc, word);
+        data += 8;
+        length -= 8;
+    }
+    while (length-- > 0) {
+        crc = __crc32cb(crc, *data++);
+    }
+    return crc;
+}
+
+static bool hasHardwareCrc() {
+    return true;
+}
+#else
+static quint32 crc32cHardware(quint32 crc, const uchar *data, qint64 length) {
+    return crc32cSoftware(crc, data, length);
+}
+
+static bool hasHardwareCrc() {
+    return false;
+}
+#endif
+
+quint32 crc32c(quint32 crc, const char *data, qint64 length) {
+    static const bool hardware = hasHardwareCrc();
+    const uchar *bytes = reinterpret_cast<const uchar*>(data);
+    crc = ~crc;
+    crc = hardware ? crc32cHardware(crc, bytes, length) : crc32cSoftware(crc, bytes, length);
+    return ~crc;
+}
+
+// Combining works in GF(2): appending n zero bytes to a CRC is a linear map,
+// built here by repeated squaring of the one-bit shift operator (as in zlib).
+static quint32 gf2MatrixTimes(const quint32 *matrix, quint32 vector) {
+    quint32 sum = 0;
+    while (vector) {
+        if (vector & 1) {
+            sum ^= *matrix;
+        }
+        vector >>= 1;
+        matrix++;
+    }
+    return sum;
+}
+
+static void gf2MatrixSquare(quint32 *square, const quint32 *matrix) {
+    for (int n = 0; n < 32; ++n) {
+        square[n] = gf2MatrixTimes(matrix, matrix[n]);
+    }
+}
+
+quint32 crc32cCombine(quint32 crcA, quint32 crcB, qint64 lengthB) {
+    if (lengthB <= 0) {
+        return crcA;
+    }
+
+    quint32 even[32];
+    quint32 odd[32];
+
+    // Operator for one zero bit.
+    odd[0] = Polynomial;
+    quint32 row = 1;
+    for (int n = 1; n < 32; ++n) {
+        odd[n] = row;
+        row <<= 1;
+    }
+    gf2MatrixSquare(even, odd);   // two zero bits
+    gf2MatrixSquare(odd, even);   // four zero bits
+
+    // Apply lengthB zero bytes to crcA, one bit of the length at a time.
+    do {
+        gf2MatrixSquare(even, odd);
+        if (lengthB & 1) {
+            crcA = gf2MatrixTimes(even, crcA);
+        }
+        lengthB >>= 1;
+        if (lengthB == 0) {
+            break;
+        }
+        gf2MatrixSquare(odd, even);
+        if (lengthB & 1) {
+            crcA = gf2MatrixTimes(odd, crcA);
+        }
+        lengthB >>= 1;
+    } while (lengthB != 0);
+
+    return crcA ^ crcB;
+}
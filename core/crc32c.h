@@ -0,0 +1,15 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <QtGlobal>
+
+// CRC-32C (Castagnoli), the checksum of iSCSI, ext4 and cloud object stores.
+// Start with crc = 0 and feed the data in any number of calls. Uses the SSE4.2
+// or ARMv8 CRC instructions when the CPU has them.
+quint32 crc32c(quint32 crc, const char *data, qint64 length);
+
+// CRC of A followed by B from crc(A), crc(B) and the length of B, so segments
+// can be checksummed in parallel and combined without reading them again.
+quint32 crc32cCombine(quint32 crcA, quint32 crcB, qint64 lengthB);
+
+#endif
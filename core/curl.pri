@@ -0,0 +1,7 @@
+# libcurl, when pkg-config finds it, adds a second HTTP transport. Included by
+# the library and by everything linking it.
+packagesExist(libcurl) {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += libcurl
+    DEFINES += FASTDOMS_HAVE_CURL
+}
@@ -0,0 +1,480 @@
+#include "curltransport.h"
+#include <QMutex>
+#include <QPointer>
+#include <QSocketNotifier>
+#include <QTimer>
+#include <cstring>
+#include <limits>
+
+#ifdef Q_OS_UNIX
+#include <sys/socket.h>
+#endif
+
+// Like Qt's default redirect policy.
+static const long MaxRedirects = 50;
+
+static QMutex shareLocks[CURL_LOCK_DATA_LAST];
+
+static void lockShare(CURL *, curl_lock_data data, curl_lock_access, void *) {
+    shareLocks[data].lock();
+}
+
+static void unlockShare(CURL *, curl_lock_data data, void *) {
+    shareLocks[data].unlock();
+}
+
+// DNS cache and TLS sessions of every multi handle, so a transfer on one I/O
+// thread resumes a session negotiated on another. Lives as long as the process.
+static CURLSH *sharedState() {
+    static CURLSH *share = []() {
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+        CURLSH *share = curl_share_init();
+        curl_share_setopt(share, CURLSHOPT_LOCKFUNC, lockShare);
+        curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, unlockShare);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+        return share;
+    }();
+    return share;
+}
+
+static QNetworkReply::NetworkError networkErrorOf(CURLcode code) {
+    switch (code) {
+    case CURLE_OK:
+        return QNetworkReply::NoError;
+    case CURLE_COULDNT_RESOLVE_HOST:
+        return QNetworkReply::HostNotFoundError;
+    case CURLE_COULDNT_RESOLVE_PROXY:
+        return QNetworkReply::ProxyNotFoundError;
+    case CURLE_COULDNT_CONNECT:
+        return QNetworkReply::ConnectionRefusedError;
+    case CURLE_OPERATION_TIMEDOUT:
+        return QNetworkReply::TimeoutError;
+    case CURLE_PARTIAL_FILE:
+    case CURLE_GOT_NOTHING:
+    case CURLE_SEND_ERROR:
+    case CURLE_RECV_ERROR:
+    case CURLE_HTTP2:
+    case CURLE_HTTP2_STREAM:
+        return QNetworkReply::RemoteHostClosedError;
+    case CURLE_SSL_CONNECT_ERROR:
+    case CURLE_PEER_FAILED_VERIFICATION:
+    case CURLE_SSL_CERTPROBLEM:
+    case CURLE_SSL_CIPHER:
+    case CURLE_SSL_CACERT_BADFILE:
+        return QNetworkReply::SslHandshakeFailedError;
+    case CURLE_TOO_MANY_REDIRECTS:
+        return QNetworkReply::TooManyRedirectsError;
+    case CURLE_UNSUPPORTED_PROTOCOL:
+        return QNetworkReply::ProtocolUnknownError;
+    case CURLE_URL_MALFORMAT:
+        return QNetworkReply::ProtocolInvalidOperationError;
+    default:
+        return QNetworkReply::UnknownNetworkError;
+    }
+}
+
+// Same codes as QNetworkReply gives for these statuses.
+static QNetworkReply::NetworkError httpErrorOf(int status) {
+    if (status < 400) {
+        return QNetworkReply::NoError;
+    }
+    switch (status) {
+    case 400:
+    case 418:
+        return QNetworkReply::ProtocolInvalidOperationError;
+    case 401:
+        return QNetworkReply::AuthenticationRequiredError;
+    case 403:
+        return QNetworkReply::ContentAccessDenied;
+    case 404:
+        return QNetworkReply::ContentNotFoundError;
+    case 405:
+        return QNetworkReply::ContentOperationNotPermittedError;
+    case 407:
+        return QNetworkReply::ProxyAuthenticationRequiredError;
+    case 409:
+        return QNetworkReply::ContentConflictError;
+    case 410:
+        return QNetworkReply::ContentGoneError;
+    case 500:
+        return QNetworkReply::InternalServerError;
+    case 501:
+        return QNetworkReply::OperationNotImplementedError;
+    case 503:
+        return QNetworkReply::ServiceUnavailableError;
+    default:
+        return status >= 500 ? QNetworkReply::UnknownServerError : QNetworkReply::UnknownContentError;
+    }
+}
+
+CurlTransport::CurlTransport(QObject *parent) : Transport(parent) {
+    sharedState();
+    multi = curl_multi_init();
+    curl_multi_setopt(multi, CURLMOPT_SOCKETFUNCTION, onSocket);
+    curl_multi_setopt(multi, CURLMOPT_SOCKETDATA, this);
+    curl_multi_setopt(multi, CURLMOPT_TIMERFUNCTION, onTimer);
+    curl_multi_setopt(multi, CURLMOPT_TIMERDATA, this);
+    curl_multi_setopt(multi, CURLMOPT_PIPELINING, long(CURLPIPE_MULTIPLEX));
+
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    connect(timer, &QTimer::timeout, this, [this]() {
+        socketAction(CURL_SOCKET_TIMEOUT, 0);
+    });
+}
+
+CurlTransport::~CurlTransport() {
+    // Replies leave the multi handle before it goes.
+    qDeleteAll(findChildren<CurlTransportReply*>(QString(), Qt::FindDirectChildrenOnly));
+    curl_multi_cleanup(multi);
+}
+
+TransportReply *CurlTransport::get(const TransportRequest &request) {
+    CurlTransportReply *reply = new CurlTransportReply(request, this);
+    CURLMcode code = curl_multi_add_handle(multi, reply->easy);
+    reply->attached = code == CURLM_OK;
+    if (!reply->attached) {
+        reply->complete(CURLE_FAILED_INIT);
+        QMetaObject::invokeMethod(this, [this]() { dispatch(); }, Qt::QueuedConnection);
+    }
+    return reply;
+}
+
+void CurlTransport::preconnect(const QUrl &url, bool http2) {
+    Q_UNUSED(url);
+    Q_UNUSED(http2);
+}
+
+int CurlTransport::onSocket(CURL *easy, curl_socket_t socket, int what, void *transport, void *socketData) {
+    Q_UNUSED(easy);
+    Q_UNUSED(socketData);
+    CurlTransport *self = static_cast<CurlTransport*>(transport);
+
+    // The notifiers may be the ones being handled: disabled now, deleted later.
+    if (what == CURL_POLL_REMOVE) {
+        auto it = self->watches.find(socket);
+        if (it != self->watches.end()) {
+            it->read->setEnabled(false);
+            it->write->setEnabled(false);
+            it->read->deleteLater();
+            it->write->deleteLater();
+            self->watches.erase(it);
+        }
+        return 0;
+    }
+
+    auto it = self->watches.find(socket);
+    if (it == self->watches.end()) {
+        Watch watch;
+        watch.read = new QSocketNotifier(socket, QSocketNotifier::Read, self);
+        watch.write = new QSocketNotifier(socket, QSocketNotifier::Write, self);
+        connect(watch.read, &QSocketNotifier::activated, self, [self, socket]() {
+            self->socketAction(socket, CURL_CSELECT_IN);
+        });
+        connect(watch.write, &QSocketNotifier::activated, self, [self, socket]() {
+            self->socketAction(socket, CURL_CSELECT_OUT);
+        });
+        it = self->watches.insert(socket, watch);
+    }
+    it->read->setEnabled(what & CURL_POLL_IN);
+    it->write->setEnabled(what & CURL_POLL_OUT);
+    return 0;
+}
+
+int CurlTransport::onTimer(CURLM *multi, long timeoutMs, void *transport) {
+    Q_UNUSED(multi);
+    CurlTransport *self = static_cast<CurlTransport*>(transport);
+    if (timeoutMs < 0) {
+        self->timer->stop();
+    } else {
+        self->timer->start(int(qMin<long>(timeoutMs, std::numeric_limits<int>::max())));
+    }
+    return 0;
+}
+
+void CurlTransport::socketAction(curl_socket_t socket, int events) {
+    int running = 0;
+    curl_multi_socket_action(multi, socket, events, &running);
+    dispatch();
+}
+
+void CurlTransport::dispatch() {
+    CURLMsg *message;
+    int left = 0;
+    while ((message = curl_multi_info_read(multi, &left))) {
+        if (message->msg != CURLMSG_DONE) {
+            continue;
+        }
+        CURLcode result = message->data.result;
+        CurlTransportReply *reply = nullptr;
+        curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &reply);
+        reply->detach();
+        reply->complete(result);
+    }
+
+    // Slots may abort or delete replies, or queue new events for the next
+    // round: each reply queued so far is looked at once, if still there.
+    QList<QPointer<CurlTransportReply>> replies;
+    replies.swap(pendingEvents);
+    for (const QPointer<CurlTransportReply> &reply : replies) {
+        if (reply) {
+            reply->queued = false;
+            reply->emitEvents();
+        }
+    }
+}
+
+CurlTransportReply::CurlTransportReply(const TransportRequest &request, CurlTransport *transport)
+    : TransportReply(transport), transport(transport), headerList(nullptr), requestUrl(request.url),
+      parsedStatus(0), status(0), http2(false), bufferOffset(0), bufferLimit(request.readBufferSize),
+      readPaused(false), attached(false), done(false), networkError(QNetworkReply::NoError), queued(false),
+      connecting(false), sent(false), headersIn(false), dataIn(false), finishing(false) {
+    errorBuffer[0] = '\0';
+    for (const auto &header : request.headers) {
+        headerList = curl_slist_append(headerList, (header.first + ": " + header.second).constData());
+    }
+
+    easy = curl_easy_init();
+    curl_easy_setopt(easy, CURLOPT_URL, request.url.toEncoded().constData());
+    curl_easy_setopt(easy, CURLOPT_PRIVATE, this);
+    curl_easy_setopt(easy, CURLOPT_SHARE, sharedState());
+    curl_easy_setopt(easy, CURLOPT_HTTPHEADER, headerList);
+    curl_easy_setopt(easy, CURLOPT_ERRORBUFFER, errorBuffer);
+    curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(easy, CURLOPT_MAXREDIRS, MaxRedirects);
+    curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION, onHeader);
+    curl_easy_setopt(easy, CURLOPT_HEADERDATA, this);
+    curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, onBody);
+    curl_easy_setopt(easy, CURLOPT_WRITEDATA, this);
+    curl_easy_setopt(easy, CURLOPT_OPENSOCKETFUNCTION, onOpenSocket);
+    curl_easy_setopt(easy, CURLOPT_OPENSOCKETDATA, this);
+#if LIBCURL_VERSION_NUM >= 0x075000
+    curl_easy_setopt(easy, CURLOPT_PREREQFUNCTION, onRequestReady);
+    curl_easy_setopt(easy, CURLOPT_PREREQDATA, this);
+#endif
+
+    if (request.http2) {
+        curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, long(CURL_HTTP_VERSION_2TLS));
+        curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+    } else {
+        curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, long(CURL_HTTP_VERSION_1_1));
+    }
+    if (request.stallTimeoutMs > 0) {
+        // Less than a byte per second over the whole period counts as a stall.
+        curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT_MS, long(request.stallTimeoutMs));
+        curl_easy_setopt(easy, CURLOPT_LOW_SPEED_LIMIT, 1L);
+        curl_easy_setopt(easy, CURLOPT_LOW_SPEED_TIME, long(qMax(1, request.stallTimeoutMs / 1000)));
+    }
+    if (bufferLimit > 0) {
+        curl_easy_setopt(easy, CURLOPT_BUFFERSIZE, long(qMin<qint64>(bufferLimit, CURL_MAX_READ_SIZE)));
+    }
+}
+
+CurlTransportReply::~CurlTransportReply() {
+    detach();
+    curl_easy_cleanup(easy);
+    curl_slist_free_all(headerList);
+}
+
+QUrl CurlTransportReply::url() const {
+    return requestUrl;
+}
+
+int CurlTransportReply::statusCode() const {
+    return status;
+}
+
+QByteArray CurlTransportReply::rawHeader(const QByteArray &name) const {
+    return headers.value(name.toLower());
+}
+
+qint64 CurlTransportReply::contentLength() const {
+    bool ok = false;
+    qint64 length = headers.value("content-length").trimmed().toLongLong(&ok);
+    return ok ? length : -1;
+}
+
+bool CurlTransportReply::http2WasUsed() const {
+    return http2;
+}
+
+qint64 CurlTransportReply::bytesAvailable() const {
+    return buffer.size() - bufferOffset;
+}
+
+qint64 CurlTransportReply::read(char *data, qint64 maxSize) {
+    qint64 count = qMin(maxSize, bytesAvailable());
+    if (count <= 0) {
+        return 0;
+    }
+    std::memcpy(data, buffer.constData() + bufferOffset, count);
+    bufferOffset += count;
+    if (bufferOffset == buffer.size()) {
+        buffer.resize(0);
+        bufferOffset = 0;
+    } else if (bufferOffset > buffer.size() / 2) {
+        buffer.remove(0, bufferOffset);
+        bufferOffset = 0;
+    }
+    resumeReading();
+    return count;
+}
+
+void CurlTransportReply::skip() {
+    buffer.resize(0);
+    bufferOffset = 0;
+    resumeReading();
+}
+
+void CurlTransportReply::abort() {
+    if (done) {
+        return;
+    }
+    detach();
+    done = true;
+    networkError = QNetworkReply::OperationCanceledError;
+    errorText = "Opération annulée";
+    connecting = sent = headersIn = dataIn = finishing = false;
+    emit finished();
+}
+
+bool CurlTransportReply::isFinished() const {
+    return done;
+}
+
+QNetworkReply::NetworkError CurlTransportReply::error() const {
+    return networkError;
+}
+
+QString CurlTransportReply::errorString() const {
+    return errorText;
+}
+
+size_t CurlTransportReply::onHeader(char *data, size_t size, size_t count, void *reply) {
+    CurlTransportReply *self = static_cast<CurlTransportReply*>(reply);
+    size_t bytes = size * count;
+    QByteArray line = QByteArray(data, qsizetype(bytes)).trimmed();
+
+    // Every response is reported, redirects and 100 Continue included: only
+    // the final one's headers are kept.
+    if (line.startsWith("HTTP/")) {
+        self->parsedStatus = line.split(' ').value(1).toInt();
+        self->headers.clear();
+    } else if (line.isEmpty()) {
+        bool redirect = self->parsedStatus >= 300 && self->parsedStatus < 400 && self->headers.contains("location");
+        if (self->parsedStatus >= 200 && !redirect) {
+            self->status = self->parsedStatus;
+            long version = 0;
+            curl_easy_getinfo(self->easy, CURLINFO_HTTP_VERSION, &version);
+            self->http2 = version == CURL_HTTP_VERSION_2_0;
+            self->headersIn = true;
+            self->queueEvents();
+        }
+    } else {
+        int colon = line.indexOf(':');
+        if (colon > 0) {
+            self->headers.insert(line.left(colon).trimmed().toLower(), line.mid(colon + 1).trimmed());
+        }
+    }
+    return bytes;
+}
+
+size_t CurlTransportReply::onBody(char *data, size_t size, size_t count, void *reply) {
+    CurlTransportReply *self = static_cast<CurlTransportReply*>(reply);
+    // Left with curl, which stops reading the socket until resumeReading().
+    if (self->bufferLimit > 0 && self->bytesAvailable() >= self->bufferLimit) {
+        self->readPaused = true;
+        return CURL_WRITEFUNC_PAUSE;
+    }
+    size_t bytes = size * count;
+    self->buffer.append(data, qsizetype(bytes));
+    self->dataIn = true;
+    self->queueEvents();
+    return bytes;
+}
+
+curl_socket_t CurlTransportReply::onOpenSocket(void *reply, curlsocktype purpose, curl_sockaddr *address) {
+    Q_UNUSED(purpose);
+    CurlTransportReply *self = static_cast<CurlTransportReply*>(reply);
+    self->connecting = true;
+    self->queueEvents();
+    return ::socket(address->family, address->socktype, address->protocol);
+}
+
+int CurlTransportReply::onRequestReady(void *reply, char *remoteIp, char *localIp, int remotePort, int localPort) {
+    Q_UNUSED(remoteIp);
+    Q_UNUSED(localIp);
+    Q_UNUSED(remotePort);
+    Q_UNUSED(localPort);
+    CurlTransportReply *self = static_cast<CurlTransportReply*>(reply);
+    self->sent = true;
+    self->queueEvents();
+#if LIBCURL_VERSION_NUM >= 0x075000
+    return CURL_PREREQFUNC_OK;
+#else
+    return 0;
+#endif
+}
+
+void CurlTransportReply::detach() {
+    if (attached) {
+        curl_multi_remove_handle(transport->multi, easy);
+        attached = false;
+    }
+}
+
+void CurlTransportReply::complete(CURLcode code) {
+    done = true;
+    finishing = true;
+    queueEvents();
+    if (code == CURLE_OK) {
+        networkError = httpErrorOf(status);
+        if (networkError != QNetworkReply::NoError) {
+            errorText = QString("Erreur HTTP %1").arg(status);
+        }
+    } else {
+        networkError = networkErrorOf(code);
+        errorText = QString::fromUtf8(errorBuffer[0] ? errorBuffer : curl_easy_strerror(code));
+    }
+}
+
+void CurlTransportReply::queueEvents() {
+    if (!queued) {
+        queued = true;
+        transport->pendingEvents.append(this);
+    }
+}
+
+void CurlTransportReply::emitEvents() {
+    // Each flag is checked again after the previous signal: a slot may have aborted.
+    if (connecting) {
+        connecting = false;
+        emit socketStartedConnecting();
+    }
+    if (sent) {
+        sent = false;
+        emit requestSent();
+    }
+    if (headersIn) {
+        headersIn = false;
+        emit metaDataChanged();
+    }
+    if (dataIn) {
+        dataIn = false;
+        emit readyRead();
+    }
+    if (finishing) {
+        finishing = false;
+        emit finished();
+    }
+}
+
+void CurlTransportReply::resumeReading() {
+    if (readPaused && attached && (bufferLimit == 0 || bytesAvailable() < bufferLimit)) {
+        readPaused = false;
+        curl_easy_pause(easy, CURLPAUSE_CONT);
+    }
+}
@@ -0,0 +1,115 @@
+#ifndef CURLTRANSPORT_H
+#define CURLTRANSPORT_H
+
+#include "transport.h"
+#include <QHash>
+#include <QList>
+#include <QPointer>
+#include <curl/curl.h>
+
+class CurlTransportReply;
+class QSocketNotifier;
+class QTimer;
+
+// libcurl's multi interface: every transfer of the I/O thread runs on one
+// multi handle. curl's socket API tells which sockets to watch; a
+// QSocketNotifier per socket and a timer on the thread's Qt event loop wake
+// it, instead of one socket and buffer chain per request.
+// HTTP/2 requests wait to be multiplexed on the connection of the others;
+// DNS results and TLS sessions are shared with every other thread's handle.
+class CurlTransport : public Transport {
+    Q_OBJECT
+
+public:
+    explicit CurlTransport(QObject *parent = nullptr);
+    ~CurlTransport();
+
+    TransportReply *get(const TransportRequest &request) override;
+    // Does nothing: libcurl keeps connect-only connections out of its pool,
+    // so no later transfer could use one.
+    void preconnect(const QUrl &url, bool http2) override;
+
+private:
+    friend class CurlTransportReply;
+
+    static int onSocket(CURL *easy, curl_socket_t socket, int what, void *transport, void *socketData);
+    static int onTimer(CURLM *multi, long timeoutMs, void *transport);
+    void socketAction(curl_socket_t socket, int events);
+    // Completes finished transfers, then emits what the callbacks recorded,
+    // once curl is no longer on the stack, for the replies that have some.
+    void dispatch();
+
+    struct Watch {
+        QSocketNotifier *read;
+        QSocketNotifier *write;
+    };
+
+    CURLM *multi;
+    QTimer *timer;
+    QHash<curl_socket_t, Watch> watches;
+    QList<QPointer<CurlTransportReply>> pendingEvents;
+};
+
+class CurlTransportReply : public TransportReply {
+    Q_OBJECT
+
+public:
+    CurlTransportReply(const TransportRequest &request, CurlTransport *transport);
+    ~CurlTransportReply();
+
+    QUrl url() const override;
+    int statusCode() const override;
+    QByteArray rawHeader(const QByteArray &name) const override;
+    qint64 contentLength() const override;
+    bool http2WasUsed() const override;
+    qint64 bytesAvailable() const override;
+    qint64 read(char *data, qint64 maxSize) override;
+    void skip() override;
+    void abort() override;
+    bool isFinished() const override;
+    QNetworkReply::NetworkError error() const override;
+    QString errorString() const override;
+
+private:
+    friend class CurlTransport;
+
+    static size_t onHeader(char *data, size_t size, size_t count, void *reply);
+    static size_t onBody(char *data, size_t size, size_t count, void *reply);
+    static curl_socket_t onOpenSocket(void *reply, curlsocktype purpose, curl_sockaddr *address);
+    static int onRequestReady(void *reply, char *remoteIp, char *localIp, int remotePort, int localPort);
+    void detach();
+    void complete(CURLcode code);
+    // Puts the reply on the transport's list for the next dispatch().
+    void queueEvents();
+    void emitEvents();
+    // Drained below the limit: lets curl read the socket again.
+    void resumeReading();
+
+    CurlTransport *transport;
+    CURL *easy;
+    curl_slist *headerList;
+    char errorBuffer[CURL_ERROR_SIZE];
+    QUrl requestUrl;
+    int parsedStatus;               // of the response being received
+    int status;                     // of the final one, once its headers are in
+    QHash<QByteArray, QByteArray> headers;  // lower-case names
+    bool http2;
+    QByteArray buffer;
+    qint64 bufferOffset;
+    qint64 bufferLimit;
+    bool readPaused;
+    bool attached;                  // still in the multi handle
+    bool done;
+    QNetworkReply::NetworkError networkError;
+    QString errorText;
+    bool queued;                    // on the transport's pendingEvents
+
+    // Seen in curl callbacks, emitted by dispatch().
+    bool connecting;
+    bool sent;
+    bool headersIn;
+    bool dataIn;
+    bool finishing;
+};
+
+#endif
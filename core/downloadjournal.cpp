@@ -0,0 +1,85 @@
+#include "downloadjournal.h"
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+
+void DownloadJournal::setPath(const QString &path) {
+    journalPath = path;
+}
+
+QString DownloadJournal::path() const {
+    return journalPath;
+}
+
+bool DownloadJournal::load() {
+    QFile file(journalPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+    if (root.isEmpty()) {
+        return false;
+    }
+
+    fileUrl = root.value("url").toString();
+    fileSize = root.value("size").toInteger();
+    fileValidator = root.value("validator").toString().toUtf8();
+    completedRanges.clear();
+    for (const QJsonValue &value : root.value("ranges").toArray()) {
+        QJsonArray range = value.toArray();
+        completedRanges.add(range.at(0).toInteger(), range.at(1).toInteger());
+    }
+    return true;
+}
+
+bool DownloadJournal::save(const RangeSet &onDisk) {
+    QJsonArray ranges;
+    for (const ByteRange &range : onDisk.ranges()) {
+        ranges.append(QJsonArray{range.start, range.end});
+    }
+
+    QJsonObject root;
+    root.insert("url", fileUrl);
+    root.insert("size", fileSize);
+    root.insert("validator", QString::fromUtf8(fileValidator));
+    root.insert("ranges", ranges);
+
+    // QSaveFile writes a temporary file and renames it, so a crash never
+    // leaves a half-written journal behind.
+    QSaveFile file(journalPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
+
+void DownloadJournal::remove() {
+    QFile::remove(journalPath);
+}
+
+void DownloadJournal::reset(const QString &url, qint64 size, const QByteArray &validator) {
+    fileUrl = url;
+    fileSize = size;
+    fileValidator = validator;
+    completedRanges.clear();
+}
+
+bool DownloadJournal::matches(qint64 size, const QByteArray &validator) const {
+    return !validator.isEmpty() && size == fileSize && validator == fileValidator;
+}
+
+qint64 DownloadJournal::size() const {
+    return fileSize;
+}
+
+QByteArray DownloadJournal::validator() const {
+    return fileValidator;
+}
+
+RangeSet &DownloadJournal::completed() {
+    return completedRanges;
+}
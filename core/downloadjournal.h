@@ -0,0 +1,36 @@
+#ifndef DOWNLOADJOURNAL_H
+#define DOWNLOADJOURNAL_H
+
+#include <QByteArray>
+#include <QString>
+#include "rangeset.h"
+
+// Small JSON file stored next to the .part file, listing the byte ranges that
+// are already on disk. It is only trusted if the remote file still has the
+// same size and validator (strong ETag or Last-Modified).
+class DownloadJournal {
+public:
+    void setPath(const QString &path);
+    QString path() const;
+
+    bool load();
+    // Writes the given ranges, which may include in-flight progress on top of completed().
+    bool save(const RangeSet &ranges);
+    void remove();
+
+    void reset(const QString &url, qint64 size, const QByteArray &validator);
+    bool matches(qint64 size, const QByteArray &validator) const;
+    qint64 size() const;
+    QByteArray validator() const;
+
+    RangeSet &completed();
+
+private:
+    QString journalPath;
+    QString fileUrl;
+    qint64 fileSize = 0;
+    QByteArray fileValidator;
+    RangeSet completedRanges;
+};
+
+#endif
@@ -0,0 +1,2085 @@
+#include "downloadmanager.h"
+#include "bufferpool.h"
+#include "iothreadpool.h"
+#include "outputfile.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QHostInfo>
+#include <QNetworkRequest>
+#include <QRandomGenerator>
+#include <QThread>
+#include <QUrl>
+#include <limits>
+
+// Each read is bounded by one pool block; this also caps what the transport buffers
+// per connection, so memory stays flat whatever the file size.
+static const int BufferBlockSize = 256 * 1024;
+static const int BuffersPerThread = 2;
+// A retired worker finishes at most this much of its range before stopping.
+static const qint64 RetireKeepBytes = 1024 * 1024;
+// How often the list of ranges already on disk is flushed to the journal.
+static const int JournalIntervalMs = 2000;
+// Retry delays double from RetryBaseDelayMs up to RetryMaxDelayMs, with jitter.
+static const int RetryBaseDelayMs = 500;
+static const int RetryMaxDelayMs = 30000;
+// A connection that delivers nothing for this long is dropped and retried.
+static const int StallTimeoutMs = 30000;
+// Progress is published at this rate (20 Hz) instead of once per packet.
+static const int ProgressIntervalMs = 50;
+// A traced segment that delivers nothing for this long is recorded as stalled.
+static const qint64 TraceStallUs = 2000000;
+// Endgame defaults: hedge once this much is left in flight, or for a segment
+// running at under a fifth of the median rate.
+static const qint64 EndgameBytes = 8 * 1024 * 1024;
+static const double StragglerRatio = 0.2;
+// While extracting, segments are cut so the contiguous prefix keeps up:
+// about eight per connection, within these bounds.
+static const qint64 FrontSliceMin = 4 * 1024 * 1024;
+static const qint64 FrontSliceMax = 64 * 1024 * 1024;
+// Streaming cuts them so the window holds about two per connection.
+static const qint64 StreamSliceMin = 1024 * 1024;
+// Files up to this size are fetched by the probe connection alone.
+static const qint64 SingleConnectionSize = 4 * 1024 * 1024;
+// Mirrors that do not answer the HEAD request in time are left out.
+static const int ProbeTimeoutMs = 15000;
+// A mirror is dropped after this many retries without delivering data, or when
+// its speed per connection stays under SlowMirrorRatio of the best mirror's
+// for SlowMirrorSamples seconds.
+static const int MirrorMaxFailures = 3;
+static const double SlowMirrorRatio = 0.1;
+static const int SlowMirrorSamples = 5;
+
+// A weak ETag cannot be used with If-Range; fall back to the date.
+template <typename Reply>
+static QByteArray validatorOf(Reply *reply) {
+    QByteArray validator = reply->rawHeader("ETag");
+    if (validator.isEmpty() || validator.startsWith("W/")) {
+        validator = reply->rawHeader("Last-Modified");
+    }
+    return validator;
+}
+
+DownloadThread::DownloadThread(int id, OutputFile *output, BufferPool *pool,
+                               Transport *transport, QObject *parent)
+    : QObject(parent), threadId(id), startByte(0), endByte(-1), writeOffset(0),
+      receivedBytes(0), progressCounter(nullptr), sourceCounter(nullptr), transferredBytes(0), writeNanos(0),
+      trace(nullptr), requestStart(0), connectStart(-1), requestSent(-1), headersReceived(-1), outputFile(output), bufferPool(pool), rateLimiter(nullptr), http2(false), validatorRejected(false), probe(false),
+      waitingForOutput(false), rangeRequests(true), rangeRequested(true), maxRetries(5), attempts(0),
+      attemptOffset(0), active(false), paused(false), transport(transport), reply(nullptr) {
+    retryTimer = new QTimer(this);
+    retryTimer->setSingleShot(true);
+    connect(retryTimer, &QTimer::timeout, this, &DownloadThread::sendRequest);
+    throttleTimer = new QTimer(this);
+    throttleTimer->setSingleShot(true);
+    connect(throttleTimer, &QTimer::timeout, this, &DownloadThread::onThrottleTimeout);
+}
+
+void DownloadThread::setRange(qint64 start, qint64 end) {
+    startByte = start;
+    writeOffset = start;
+    endByte.storeRelaxed(end);
+    receivedBytes.storeRelaxed(0);
+}
+
+void DownloadThread::shrinkEnd(qint64 end) {
+    qint64 current = endByte.loadRelaxed();
+    while (end < current && !endByte.testAndSetRelaxed(current, end, current)) {
+    }
+}
+
+void DownloadThread::setValidator(const QByteArray &value) {
+    validator = value;
+}
+
+void DownloadThread::setMaxRetries(int count) {
+    maxRetries = count;
+}
+
+void DownloadThread::setRateLimiter(RateLimiter *limiter) {
+    rateLimiter = limiter;
+}
+
+void DownloadThread::setHttp2(bool enabled, const QHttp2Configuration &configuration) {
+    http2 = enabled;
+    http2Configuration = configuration;
+}
+
+void DownloadThread::setProbe(bool enabled) {
+    probe = enabled;
+}
+
+void DownloadThread::setConditional(const QByteArray &value) {
+    conditional = value;
+}
+
+void DownloadThread::setProgressCounter(QAtomicInteger<qint64> *total) {
+    progressCounter = total;
+}
+
+void DownloadThread::setSource(const QString &url, QAtomicInteger<qint64> *sourceBytes) {
+    downloadUrl = url;
+    sourceCounter = sourceBytes;
+}
+
+qint64 DownloadThread::received() const {
+    return receivedBytes.loadRelaxed();
+}
+
+void DownloadThread::setTrace(TraceRecorder *recorder) {
+    trace = recorder;
+}
+
+qint64 DownloadThread::transferred() const {
+    return transferredBytes.loadRelaxed();
+}
+
+qint64 DownloadThread::writeTime() const {
+    return writeNanos.loadRelaxed();
+}
+
+void DownloadThread::start() {
+    attempts = 0;
+    active = true;
+    if (!paused) {
+        sendRequest();
+    }
+}
+
+void DownloadThread::pause() {
+    paused = true;
+    retryTimer->stop();
+    throttleTimer->stop();
+    if (reply) {
+        reply->abort();
+    }
+}
+
+void DownloadThread::stop() {
+    active = false;
+    paused = true;
+    retryTimer->stop();
+    throttleTimer->stop();
+    if (reply) {
+        reply->abort();
+    }
+}
+
+void DownloadThread::resume() {
+    paused = false;
+    if (active && !reply) {
+        attempts = 0;
+        sendRequest();
+    }
+}
+
+void DownloadThread::switchSource(const QString &url, QAtomicInteger<qint64> *sourceBytes) {
+    setSource(url, sourceBytes);
+    retryTimer->stop();
+    throttleTimer->stop();
+    if (reply) {
+        if (trace) {
+            traceFinished();
+        }
+        disconnect(reply, nullptr, this, nullptr);
+        reply->abort();
+        reply->deleteLater();
+        reply = nullptr;
+    }
+
+    attempts = 0;
+    active = true;
+    if (!paused) {
+        sendRequest();
+    }
+}
+
+void DownloadThread::abandon() {
+    // Finished or failed in the meantime: the manager saw that instead.
+    if (!active) {
+        return;
+    }
+    retryTimer->stop();
+    throttleTimer->stop();
+    if (reply) {
+        if (trace) {
+            traceFinished();
+        }
+        disconnect(reply, nullptr, this, nullptr);
+        reply->abort();
+        reply->deleteLater();
+        reply = nullptr;
+    }
+    active = false;
+    emit chunkAbandoned(threadId);
+}
+
+void DownloadThread::preconnect() {
+    transport->preconnect(QUrl(downloadUrl), http2);
+}
+
+void DownloadThread::attachOutput(OutputFile *output, bool rangeRequests) {
+    outputFile = output;
+    this->rangeRequests = rangeRequests;
+    waitingForOutput = false;
+
+    if (reply) {
+        onReadyRead();
+        if (reply && reply->isFinished()) {
+            onFinished();
+        }
+    }
+}
+
+void DownloadThread::sendRequest() {
+    // Another worker may have taken the rest of the range while we waited.
+    if (writeOffset > endByte.loadRelaxed()) {
+        active = false;
+        emit chunkDownloaded(threadId);
+        return;
+    }
+
+    // Without Range support the server can only send everything again.
+    if (!rangeRequests && writeOffset > startByte) {
+        qint64 counted = receivedBytes.fetchAndStoreRelaxed(0);
+        if (progressCounter) {
+            progressCounter->fetchAndSubRelaxed(counted);
+        }
+        if (sourceCounter) {
+            sourceCounter->fetchAndSubRelaxed(counted);
+        }
+        writeOffset = startByte;
+    }
+
+    writeError.clear();
+    diskError.clear();
+    validatorRejected = false;
+    attemptOffset = writeOffset;
+    rangeRequested = rangeRequests;
+
+    // Retries resume at the first byte not yet written. A probe asks for an
+    // open-ended range: the manager shrinks it once the size is known.
+    TransportRequest request;
+    request.url = QUrl(downloadUrl);
+    if (rangeRequests) {
+        qint64 end = endByte.loadRelaxed();
+        QString range = end == OpenEnd ? QString("bytes=%1-").arg(writeOffset)
+                                       : QString("bytes=%1-%2").arg(writeOffset).arg(end);
+        request.headers.append({"Range", range.toUtf8()});
+        if (!validator.isEmpty()) {
+            request.headers.append({"If-Range", validator});
+        }
+    }
+    if (probe && !conditional.isEmpty()) {
+        request.headers.append({conditional.startsWith('"') ? "If-None-Match" : "If-Modified-Since", conditional});
+    }
+    // Byte offsets must match the file, not a transparently decompressed body.
+    request.headers.append({"Accept-Encoding", "identity"});
+    request.stallTimeoutMs = StallTimeoutMs;
+    request.readBufferSize = bufferPool->blockSize();
+    request.http2 = http2;
+    request.http2Configuration = http2Configuration;
+
+    reply = transport->get(request);
+    if (probe) {
+        connect(reply, &TransportReply::metaDataChanged, this, &DownloadThread::onMetaDataChanged);
+    }
+    connect(reply, &TransportReply::readyRead, this, &DownloadThread::onReadyRead);
+    connect(reply, &TransportReply::finished, this, &DownloadThread::onFinished);
+    if (trace) {
+        traceRequest();
+    }
+}
+
+void DownloadThread::traceRequest() {
+    // The transport reports when a new socket starts connecting and when the
+    // request is out; DNS is part of the connection and TLS ends just before the send.
+    requestStart = trace->now();
+    connectStart = -1;
+    requestSent = -1;
+    headersReceived = -1;
+    int track = threadId + 1;
+
+    connect(reply, &TransportReply::socketStartedConnecting, this, [this, track]() {
+        if (connectStart < 0) {
+            connectStart = trace->now();
+            trace->span(track, "queue", requestStart, connectStart);
+        }
+    });
+    connect(reply, &TransportReply::requestSent, this, [this, track]() {
+        if (requestSent >= 0) {
+            return;
+        }
+        requestSent = trace->now();
+        if (connectStart >= 0) {
+            trace->span(track, "connect", connectStart, requestSent, {{"tls", reply->url().scheme() == "https"}});
+        } else {
+            // Reused keep-alive connection: only the wait for a free one.
+            trace->span(track, "queue", requestStart, requestSent, {{"reused", true}});
+        }
+    });
+    connect(reply, &TransportReply::metaDataChanged, this, [this, track]() {
+        if (headersReceived >= 0) {
+            return;
+        }
+        headersReceived = trace->now();
+        trace->span(track, "ttfb", requestSent >= 0 ? requestSent : requestStart, headersReceived,
+                    {{"status", reply->statusCode()}, {"http2", reply->http2WasUsed()}});
+    });
+}
+
+void DownloadThread::traceFinished() {
+    int track = threadId + 1;
+    qint64 end = trace->now();
+    QJsonObject args{{"from", attemptOffset}, {"bytes", writeOffset - attemptOffset}};
+    if (reply->error() != QNetworkReply::NoError) {
+        args.insert("error", reply->errorString());
+    }
+    if (headersReceived >= 0) {
+        trace->span(track, "transfer", headersReceived, end, {{"bytes", writeOffset - attemptOffset}});
+    }
+    trace->span(track, "request", requestStart, end, args);
+}
+
+void DownloadThread::onMetaDataChanged() {
+    int status = reply->statusCode();
+    if (probe && status == 304) {
+        // The cached copy is current; there is no body to wait for.
+        probe = false;
+        waitingForOutput = true;
+        emit notModified(threadId);
+        return;
+    }
+    if (!probe || status < 200 || status >= 300) {
+        // Errors go through onFinished and the usual retries.
+        return;
+    }
+    probe = false;
+    waitingForOutput = true;
+
+    qint64 size = -1;
+    bool rangesSupported;
+    if (status == 206) {
+        // Content-Range: bytes first-last/size
+        QByteArray contentRange = reply->rawHeader("Content-Range");
+        bool ok = false;
+        size = contentRange.mid(contentRange.indexOf('/') + 1).trimmed().toLongLong(&ok);
+        if (!ok) {
+            size = -1;
+        }
+        rangesSupported = true;
+    } else {
+        // The whole file from byte 0: Range is not supported, or If-Range
+        // failed because the file changed since the journal was written.
+        size = reply->contentLength();
+        rangesSupported = !validator.isEmpty() && reply->rawHeader("Accept-Ranges").trimmed().toLower() == "bytes";
+        startByte = 0;
+        writeOffset = 0;
+        rangeRequested = false;
+    }
+
+    if (size >= 0 && endByte.loadRelaxed() == OpenEnd) {
+        endByte.storeRelaxed(size - 1);
+    }
+    validator = validatorOf(reply);
+    emit probed(threadId, writeOffset, size, validator, rangesSupported);
+}
+
+void DownloadThread::onReadyRead() {
+    if (!reply || !writeError.isEmpty() || !diskError.isEmpty() || waitingForOutput) {
+        return;
+    }
+
+    int status = reply->statusCode();
+    if (status >= 300) {
+        // Error page: onFinished reports the HTTP error.
+        reply->skip();
+        return;
+    }
+
+    // A 200 means the whole file from byte 0: either the server ignores Range,
+    // or If-Range no longer matches because the file changed.
+    if (status != 206 && rangeRequested && (writeOffset > 0 || !validator.isEmpty())) {
+        validatorRejected = !validator.isEmpty();
+        writeError = validatorRejected ? "Le fichier distant a changé" : "Le serveur a ignoré la requête Range";
+        reply->abort();
+        return;
+    }
+
+    while (reply->bytesAvailable() > 0 && writeOffset <= endByte.loadRelaxed()) {
+        qint64 wanted = qMin<qint64>(bufferPool->blockSize(), endByte.loadRelaxed() - writeOffset + 1);
+        wanted = qMin(wanted, reply->bytesAvailable());
+
+        // Unread data stays in the capped reply buffer, so TCP backpressure
+        // slows the server down while the limiter holds us back.
+        qint64 granted = rateLimiter ? rateLimiter->acquire(wanted) : wanted;
+        if (granted <= 0) {
+            if (!throttleTimer->isActive()) {
+                throttleTimer->start(rateLimiter->delayFor(wanted));
+            }
+            return;
+        }
+
+        char *block = bufferPool->acquire();
+        qint64 read = reply->read(block, granted);
+        QElapsedTimer writeTimer;
+        if (trace) {
+            writeTimer.start();
+        }
+        bool written = read > 0 && outputFile->writeAt(writeOffset, block, read);
+        if (trace) {
+            writeNanos.fetchAndAddRelaxed(writeTimer.nsecsElapsed());
+        }
+        bufferPool->release(block);
+
+        if (read <= 0) {
+            break;
+        }
+        transferredBytes.fetchAndAddRelaxed(read);
+        if (!written) {
+            diskError = outputFile->errorString();
+            reply->abort();
+            return;
+        }
+        // Only bytes inside the range count; a stolen tail is counted by its thief.
+        qint64 counted = qMin(read, endByte.loadRelaxed() - writeOffset + 1);
+        writeOffset += read;
+        if (counted > 0) {
+            receivedBytes.storeRelaxed(writeOffset - startByte);
+            if (progressCounter) {
+                progressCounter->fetchAndAddRelaxed(counted);
+            }
+            if (sourceCounter) {
+                sourceCounter->fetchAndAddRelaxed(counted);
+            }
+        }
+    }
+
+    // Everything this segment owns is on disk; drop whatever the server still sends.
+    if (writeOffset > endByte.loadRelaxed() && reply->isRunning()) {
+        reply->abort();
+    }
+}
+
+void DownloadThread::onThrottleTimeout() {
+    if (!reply) {
+        return;
+    }
+    onReadyRead();
+    if (reply && reply->isFinished()) {
+        onFinished();
+    }
+}
+
+void DownloadThread::onFinished() {
+    // A probe's body is kept until attachOutput() finishes it.
+    if (waitingForOutput) {
+        return;
+    }
+
+    if (reply->error() == QNetworkReply::NoError) {
+        onReadyRead();
+        // Throttled tail: onThrottleTimeout() finishes once it is drained.
+        if (reply && throttleTimer->isActive()) {
+            return;
+        }
+    }
+
+    if (trace) {
+        traceFinished();
+    }
+
+    // Aborted by pause() or stop(): nothing to report.
+    if (paused) {
+        reply->deleteLater();
+        reply = nullptr;
+        return;
+    }
+
+    QString error;
+    if (validatorRejected) {
+        active = false;
+        emit remoteFileChanged(threadId);
+    } else if (!diskError.isEmpty()) {
+        active = false;
+        emit writeFailed(threadId, diskError);
+    } else if (!writeError.isEmpty()) {
+        active = false;
+        emit chunkError(threadId, writeError);
+    } else if (writeOffset > endByte.loadRelaxed()
+               || (endByte.loadRelaxed() == OpenEnd && reply->error() == QNetworkReply::NoError)) {
+        // An open range ends with the stream when the server never gave a size.
+        active = false;
+        emit chunkDownloaded(threadId);
+    } else if (reply->error() != QNetworkReply::NoError) {
+        error = reply->errorString();
+    } else {
+        error = QString("Segment incomplet: %1 octets manquants").arg(endByte.loadRelaxed() - writeOffset + 1);
+    }
+
+    if (!error.isEmpty()) {
+        // The budget counts consecutive attempts that made no progress.
+        if (writeOffset > attemptOffset) {
+            attempts = 0;
+        }
+
+        if (isTransientError() && attempts < maxRetries) {
+            int delay = qMin(RetryBaseDelayMs << qMin(attempts, 16), RetryMaxDelayMs);
+            delay = delay / 2 + QRandomGenerator::global()->bounded(delay / 2 + 1);
+            attempts++;
+            emit chunkRetrying(threadId, attempts, delay, error);
+            retryTimer->start(delay);
+        } else {
+            active = false;
+            emit chunkError(threadId, error);
+        }
+    }
+
+    reply->deleteLater();
+    reply = nullptr;
+}
+
+bool DownloadThread::isTransientError() const {
+    switch (reply->error()) {
+    case QNetworkReply::NoError:                        // connection closed before the end
+    case QNetworkReply::RemoteHostClosedError:
+    case QNetworkReply::TimeoutError:
+    case QNetworkReply::OperationCanceledError:         // transfer timeout
+    case QNetworkReply::TemporaryNetworkFailureError:
+    case QNetworkReply::NetworkSessionFailedError:
+    case QNetworkReply::ProxyConnectionClosedError:
+    case QNetworkReply::ProxyTimeoutError:
+    case QNetworkReply::UnknownNetworkError:
+        return true;
+    default:
+        break;
+    }
+
+    int status = reply->statusCode();
+    return status == 408 || status == 429 || status >= 500;
+}
+
+DownloadManager::DownloadManager(QObject *parent)
+    : QObject(parent), fileSize(0), numThreads(0), fixedConnections(0), desiredConnections(0),
+      connectionAllowance(std::numeric_limits<int>::max()), maxRetries(5), endgameBytes(EndgameBytes),
+      stragglerRatio(StragglerRatio), protocol(Http1), http2Connections(1),
+      rateLimiter(RateLimiter::global()), paused(false), probing(false), singleStream(false), preconnect(false),
+      backend(Transport::QtNetwork), bufferPool(nullptr), receivedBytes(0), lastPercentage(-1), lastBytesReceived(0),
+      lastTraceSample(0), traceWriteNanos(0), dnsLookup(-1), cache(nullptr), cacheBypass(false), streamWindow(0),
+      processingCached(false), taskGeneration(0), journalEpoch(0) {
+    headManager = new QNetworkAccessManager(this);
+    speedTimer = new QTimer(this);
+    connect(speedTimer, &QTimer::timeout, this, &DownloadManager::updateSpeed);
+    progressTimer = new QTimer(this);
+    progressTimer->setInterval(ProgressIntervalMs);
+    connect(progressTimer, &QTimer::timeout, this, &DownloadManager::publishProgress);
+    verifier = new IntegrityVerifier(this);
+    connect(verifier, &IntegrityVerifier::pieceFailed, this, &DownloadManager::onPieceFailed);
+    connect(verifier, &IntegrityVerifier::finished, this, &DownloadManager::onVerificationFinished);
+    extractor = new StreamExtractor(this);
+    connect(extractor, &StreamExtractor::finished, this, &DownloadManager::onExtractionFinished);
+    streamer = new PrefixStreamer(this);
+    connect(streamer, &PrefixStreamer::finished, this, &DownloadManager::onStreamFinished);
+    journalTimer = new QTimer(this);
+    connect(journalTimer, &QTimer::timeout, this, &DownloadManager::saveJournal);
+    // Every way a download ends goes through downloadFinished.
+    connect(this, &DownloadManager::downloadFinished, this, &DownloadManager::finishTrace);
+}
+
+DownloadManager::~DownloadManager() {
+    cancel();
+    // A file being added to the cache is left complete.
+    fileTasks.waitForDone();
+    qDeleteAll(mirrors);
+}
+
+void DownloadManager::setConnectionLimits(int minimum, int maximum) {
+    tuner.setLimits(minimum, maximum);
+}
+
+void DownloadManager::setFixedConnections(int count) {
+    fixedConnections = qMax(0, count);
+}
+
+void DownloadManager::setConnectionAllowance(int count) {
+    connectionAllowance = qMax(0, count);
+    updateConnectionTarget();
+}
+
+int DownloadManager::connectionDemand() const {
+    return desiredConnections;
+}
+
+void DownloadManager::setEndgame(qint64 remainingBytes, double ratio) {
+    endgameBytes = qMax<qint64>(0, remainingBytes);
+    stragglerRatio = qMax(0.0, ratio);
+}
+
+void DownloadManager::setProtocol(Protocol value) {
+    protocol = value;
+}
+
+void DownloadManager::setHttp2Connections(int count) {
+    http2Connections = qMax(1, count);
+}
+
+void DownloadManager::setHttp2Windows(qint32 streamWindow, qint32 sessionWindow) {
+    http2Configuration = QHttp2Configuration();
+    if (streamWindow > 0) {
+        http2Configuration.setStreamReceiveWindowSize(streamWindow);
+    }
+    if (sessionWindow > 0) {
+        http2Configuration.setSessionReceiveWindowSize(sessionWindow);
+    }
+}
+
+void DownloadManager::setMaxRetries(int count) {
+    maxRetries = qMax(0, count);
+}
+
+void DownloadManager::setRateLimit(qint64 bytesPerSecond) {
+    rateLimiter.setRate(bytesPerSecond);
+}
+
+void DownloadManager::setGlobalRateLimit(qint64 bytesPerSecond) {
+    RateLimiter::global()->setRate(bytesPerSecond);
+}
+
+void DownloadManager::setExpectedDigest(IntegrityVerifier::Algorithm algorithm, const QByteArray &digest) {
+    verifier->setExpectedDigest(algorithm, digest);
+    expectedSha256 = algorithm == IntegrityVerifier::Sha256 ? digest.toHex() : QByteArray();
+}
+
+void DownloadManager::setPieceDigests(IntegrityVerifier::Algorithm algorithm, qint64 pieceLength,
+                                      const QList<QByteArray> &digests) {
+    verifier->setPieceDigests(algorithm, pieceLength, digests);
+}
+
+void DownloadManager::setMirrors(const QStringList &urls) {
+    mirrorUrls = urls;
+}
+
+void DownloadManager::setProgressInterval(int milliseconds) {
+    progressTimer->setInterval(qMax(1, milliseconds));
+}
+
+void DownloadManager::setTraceFile(const QString &path) {
+    traceFile = path;
+}
+
+void DownloadManager::setPreconnect(bool enabled) {
+    preconnect = enabled;
+}
+
+void DownloadManager::setTransport(Transport::Backend value) {
+    backend = Transport::isAvailable(value) ? value : Transport::QtNetwork;
+}
+
+void DownloadManager::setCache(ContentCache *value) {
+    cache = value;
+}
+
+void DownloadManager::setDelta(const ZsyncManifest &manifest, const QString &seedPath) {
+    delta = manifest;
+    deltaSeed = seedPath;
+}
+
+void DownloadManager::setExtraction(const QString &directory) {
+    extractDirectory = directory;
+}
+
+void DownloadManager::setStreamOutput(const QString &target, qint64 window) {
+    streamTarget = target;
+    streamWindow = qMax<qint64>(0, window);
+}
+
+void DownloadManager::pause() {
+    if (paused) {
+        return;
+    }
+    paused = true;
+    for (DownloadThread *thread : threads) {
+        QMetaObject::invokeMethod(thread, &DownloadThread::pause, Qt::QueuedConnection);
+    }
+    saveJournal();
+    emit logMessage("⏸ Téléchargement en pause: connexions fermées");
+}
+
+void DownloadManager::resume() {
+    if (!paused) {
+        return;
+    }
+    paused = false;
+    tuner.reset();
+    desiredConnections = fixedConnections > 0 ? fixedConnections : tuner.minimum();
+    emit connectionDemandChanged(desiredConnections);
+    for (DownloadThread *thread : threads) {
+        QMetaObject::invokeMethod(thread, &DownloadThread::resume, Qt::QueuedConnection);
+    }
+    emit logMessage("▶ Reprise du téléchargement");
+}
+
+bool DownloadManager::isPaused() const {
+    return paused;
+}
+
+void DownloadManager::cancel(bool deletePartial) {
+    if (dnsLookup >= 0) {
+        QHostInfo::abortHostLookup(dnsLookup);
+        dnsLookup = -1;
+    }
+    abortHeadRequests();
+    // A copy from the cache still running finishes unreported.
+    taskGeneration++;
+
+    bool running = !threads.isEmpty();
+    speedTimer->stop();
+    progressTimer->stop();
+    journalTimer->stop();
+    verifier->reset();
+    extractor->reset();
+    streamer->reset();
+
+    if (running && !deletePartial) {
+        saveJournal();
+    }
+    releaseWorkers();
+    outputFile.reset();
+
+    if (deletePartial && !fileSavePath.isEmpty()) {
+        QFile::remove(fileSavePath + ".part");
+        removeJournal();
+    }
+    if (running) {
+        emit logMessage("✖ Téléchargement annulé");
+    }
+    finishTrace();
+}
+
+void DownloadManager::abortHeadRequests() {
+    for (QNetworkReply *reply : headReplies) {
+        disconnect(reply, nullptr, this, nullptr);
+        reply->abort();
+        reply->deleteLater();
+    }
+    headReplies.clear();
+}
+
+void DownloadManager::releaseWorkers() {
+    // Last disk times, and stalls still open, before the workers go.
+    if (trace.isRunning()) {
+        sampleTrace(true);
+    }
+
+    IoThreadPool *pool = IoThreadPool::instance();
+    for (int i = 0; i < threads.size(); ++i) {
+        QMetaObject::invokeMethod(threads[i], &DownloadThread::stop, Qt::BlockingQueuedConnection);
+        threads[i]->deleteLater();
+        pool->release(ioThreads[i]);
+    }
+    threads.clear();
+    ioThreads.clear();
+    retired.clear();
+    threadPercentages.clear();
+    workerMirror.clear();
+    traceSamples.clear();
+    numThreads = 0;
+    probing = false;
+
+    // Drop progress and completion signals queued before the workers stopped.
+    QCoreApplication::removePostedEvents(this, QEvent::MetaCall);
+
+    scheduler.reset({}, 0);
+    delete bufferPool;
+    bufferPool = nullptr;
+}
+
+void DownloadManager::failDownload(const QString &log, const QString &message) {
+    speedTimer->stop();
+    progressTimer->stop();
+    journalTimer->stop();
+    verifier->reset();
+    extractor->reset();
+    streamer->reset();
+    saveJournal();
+    releaseWorkers();
+    outputFile.reset();
+
+    emit logMessage(log);
+    emit downloadFinished(false, message);
+}
+
+void DownloadManager::startDownload(const QString &url, const QString &savePath) {
+    cancel();
+
+    fileUrl = url;
+    fileSavePath = savePath;
+    fileSize = -1;
+    fileValidator.clear();
+    receivedBytes.storeRelaxed(0);
+    lastBytesReceived = 0;
+    lastPercentage = -1;
+    pieceRetries.clear();
+    paused = false;
+    singleStream = false;
+    processingCached = false;
+    extractionError.clear();
+    streamError.clear();
+    tuner.reset();
+    desiredConnections = fixedConnections > 0 ? fixedConnections : tuner.minimum();
+    emit connectionDemandChanged(desiredConnections);
+
+    qDeleteAll(mirrors);
+    mirrors.clear();
+    QStringList urls{url};
+    for (const QString &mirror : mirrorUrls) {
+        if (!urls.contains(mirror)) {
+            urls.append(mirror);
+        }
+    }
+    for (const QString &source : urls) {
+        Mirror *mirror = new Mirror;
+        mirror->url = source;
+        mirrors.append(mirror);
+    }
+
+    // A cached copy is only used once the server confirms it is current,
+    // unless the expected SHA-256 already names a cached content.
+    cached = ContentCache::Entry();
+    if (cache && !cacheBypass) {
+        if (!expectedSha256.isEmpty() && cache->contains(expectedSha256)) {
+            emit logMessage("🗃 Contenu déjà en cache (même SHA-256): aucune requête");
+            serveFromCache(expectedSha256);
+            return;
+        }
+        if (cache->lookup(url, cached) && !cached.validator.isEmpty()
+            && (expectedSha256.isEmpty() || cached.digest == expectedSha256)) {
+            emit logMessage(QString("🗃 Copie en cache (%1): vérification auprès du serveur").arg(formatSize(cached.size)));
+        } else {
+            cached = ContentCache::Entry();
+        }
+    }
+    cacheBypass = false;
+
+    // An earlier attempt continues at its first missing byte, including one
+    // seeded from an older copy that had not reached the server yet.
+    QString partPath = fileSavePath + ".part";
+    journal.setPath(partPath + ".json");
+    bool resumable = journal.load() && QFileInfo(partPath).size() == journal.size()
+                     && (!journal.validator().isEmpty() || (delta.isValid() && journal.size() == delta.length));
+
+    if (!resumable && delta.isValid() && QFileInfo::exists(deltaSeed)) {
+        emit logMessage(QString("🔁 Recherche des blocs inchangés dans %1...").arg(deltaSeed));
+        ZsyncManifest manifest = delta;
+        QString seed = deltaSeed;
+        int generation = taskGeneration;
+        fileTasks.start([this, manifest, seed, partPath, generation]() {
+            RangeSet reused;
+            QString error;
+            OutputFile output;
+            bool success = output.open(partPath, manifest.length) && manifest.reuse(seed, &output, reused, &error);
+            if (error.isEmpty()) {
+                error = output.errorString();
+            }
+            output.close();
+            QMetaObject::invokeMethod(this, [=]() {
+                onSeedScanned(generation, success, reused, error);
+            }, Qt::QueuedConnection);
+        });
+        return;
+    }
+    startTransfer(resumable);
+}
+
+void DownloadManager::onSeedScanned(int generation, bool success, const RangeSet &reused, const QString &error) {
+    if (generation != taskGeneration) {
+        return;
+    }
+    if (!success) {
+        emit logMessage("⚠ Ancienne version inutilisable (" + error + "): téléchargement complet");
+        startTransfer(false);
+        return;
+    }
+
+    // No validator yet: onProbed() takes the blocks if the size matches.
+    journal.reset(fileUrl, delta.length, QByteArray());
+    journal.completed() = reused;
+    writeJournal(reused);
+    emit logMessage(QString("🔁 %1 repris de l'ancienne version, %2 à télécharger")
+                        .arg(formatSize(reused.totalLength()))
+                        .arg(formatSize(delta.length - reused.totalLength())));
+    startTransfer(true);
+}
+
+void DownloadManager::startTransfer(bool resumable) {
+    // If-Range makes the server send the whole file instead if it changed
+    // since the journal was written.
+    qint64 probeStart = 0;
+    QByteArray probeValidator;
+    if (resumable) {
+        QList<ByteRange> missing = journal.completed().missing(journal.size());
+        probeStart = missing.isEmpty() ? qMax<qint64>(0, journal.size() - 1) : missing.first().start;
+        probeValidator = journal.validator();
+    }
+
+    emit logMessage("🔍 Connexion au serveur...");
+    if (!traceFile.isEmpty()) {
+        trace.start();
+        lastTraceSample = 0;
+        traceWriteNanos = 0;
+
+        // Sockets resolve the host themselves; this lookup times it and
+        // leaves the answer in Qt's host cache for them.
+        QString host = QUrl(fileUrl).host();
+        dnsLookup = QHostInfo::lookupHost(host, this, [this, host](const QHostInfo &info) {
+            dnsLookup = -1;
+            QJsonObject args{{"host", host}, {"addresses", int(info.addresses().size())}};
+            if (info.error() != QHostInfo::NoError) {
+                args.insert("error", info.errorString());
+            }
+            trace.span(TraceRecorder::DownloadTrack, "dns", 0, trace.now(), args);
+        });
+    }
+    if (protocol == Http2) {
+        if (QUrl(fileUrl).scheme() == "https") {
+            emit logMessage(QString("🔀 HTTP/2: segments multiplexés sur %1 connexion(s) par serveur").arg(http2Connections));
+        } else {
+            emit logMessage("⚠ HTTP/2 n'est négocié qu'en https: les segments passent en HTTP/1.1");
+        }
+    }
+
+    // No HEAD round trip: the first connection fetches data right away and its
+    // response headers give the size. The others follow once it is known.
+    int maxConnections = fixedConnections > 0 ? fixedConnections : tuner.maximum();
+    bufferPool = new BufferPool(maxConnections * BuffersPerThread, BufferBlockSize);
+    probing = true;
+    int id = addWorker();
+    numThreads = 1;
+    workerMirror[id] = 0;
+
+    DownloadThread *thread = threads[id];
+    thread->setRange(probeStart, DownloadThread::OpenEnd);
+    thread->setValidator(probeValidator);
+    thread->setProbe(true);
+    thread->setConditional(cached.validator);
+    thread->setSource(mirrors[0]->url, &mirrors[0]->bytes);
+    QMetaObject::invokeMethod(thread, &DownloadThread::start, Qt::QueuedConnection);
+
+    // Workers for the first fan-out, each connecting meanwhile in its own
+    // network manager. Retired until then, they are the first woken.
+    // libcurl cannot hand a connect-only connection to a later transfer.
+    if (preconnect && backend == Transport::QtNetwork) {
+        int count = qMin(desiredConnections, connectionAllowance);
+        if (protocol == Http2) {
+            count = qMin(count, http2Connections);
+        }
+        QVector<int> spare;
+        for (int i = 1; i < count; ++i) {
+            spare.append(addWorker());
+        }
+        for (int extra : spare) {
+            retired[extra] = true;
+            threads[extra]->setSource(mirrors[0]->url, &mirrors[0]->bytes);
+            QMetaObject::invokeMethod(threads[extra], &DownloadThread::preconnect, Qt::QueuedConnection);
+        }
+        if (!spare.isEmpty()) {
+            emit logMessage(QString("🔌 Pré-connexion de %1 connexion(s) pendant la première requête").arg(spare.size()));
+        }
+    }
+
+    // Other mirrors only get a HEAD; they are used once they agree with the probe.
+    for (int i = 1; i < mirrors.size(); ++i) {
+        QNetworkRequest headRequest(mirrors[i]->url);
+        headRequest.setTransferTimeout(ProbeTimeoutMs);
+        headRequest.setRawHeader("Accept-Encoding", "identity");
+        QNetworkReply *reply = headManager->head(headRequest);
+        reply->setProperty("mirror", i);
+        headReplies.append(reply);
+        connect(reply, &QNetworkReply::finished, this, &DownloadManager::onHeadFinished);
+    }
+}
+
+void DownloadManager::onHeadFinished() {
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    headReplies.removeOne(reply);
+    reply->deleteLater();
+
+    int index = reply->property("mirror").toInt();
+    Mirror *mirror = mirrors[index];
+    mirror->probed = true;
+    if (reply->error() != QNetworkReply::NoError) {
+        mirror->probeError = reply->errorString();
+    } else {
+        QVariant length = reply->header(QNetworkRequest::ContentLengthHeader);
+        mirror->probedSize = length.isValid() ? length.toLongLong() : -1;
+        mirror->probedValidator = validatorOf(reply);
+    }
+
+    if (!probing) {
+        checkMirror(index);
+    }
+}
+
+void DownloadManager::checkMirror(int index) {
+    Mirror *mirror = mirrors[index];
+    if (mirror->dropped || mirror->verified || !mirror->probed) {
+        return;
+    }
+
+    // Bytes from two mirrors are only mixed if both serve the same version.
+    if (!mirror->probeError.isEmpty()) {
+        dropMirror(index, mirror->probeError);
+    } else if (mirror->probedSize != fileSize) {
+        dropMirror(index, QString("taille différente (%1)").arg(mirror->probedSize));
+    } else if (mirror->probedValidator != fileValidator) {
+        dropMirror(index, QString("version différente (%1 au lieu de %2)")
+                              .arg(QString(mirror->probedValidator), QString(fileValidator)));
+    } else {
+        mirror->verified = true;
+        emit logMessage(QString("🪞 Miroir en accord, utilisé: %1").arg(mirror->url));
+    }
+}
+
+void DownloadManager::onProbed(int id, qint64 start, qint64 size, const QByteArray &validator, bool rangesSupported) {
+    probing = false;
+    fileSize = size;
+    fileValidator = validator;
+    mirrors[workerMirror[id]]->verified = true;
+
+    // Bytes of an earlier attempt are reused only if the remote file is
+    // unchanged; blocks from an older copy if it has the manifest's size (the
+    // expected SHA-1 checks the rest).
+    QString partPath = fileSavePath + ".part";
+    bool seeded = delta.isValid() && journal.validator().isEmpty() && journal.size() == delta.length
+                  && !journal.completed().isEmpty();
+    bool resume = rangesSupported && QFileInfo(partPath).size() == fileSize
+                  && (journal.matches(fileSize, fileValidator) || (seeded && fileSize == delta.length));
+    if (seeded && !resume) {
+        emit logMessage("⚠ Le fichier distant ne correspond pas au manifeste zsync: téléchargement complet");
+    }
+    if (!resume) {
+        journal.reset(fileUrl, fileSize, fileValidator);
+    } else if (seeded) {
+        RangeSet reused = journal.completed();
+        journal.reset(fileUrl, fileSize, fileValidator);
+        journal.completed() = reused;
+    }
+
+    // Without Range support, or for a small file, one connection does it all.
+    singleStream = !rangesSupported || fileSize < 0 || fileSize <= SingleConnectionSize;
+
+    if (fileSize >= 0) {
+        emit fileSizeReceived(formatSize(fileSize));
+        emit logMessage(QString("📊 Taille du fichier: %1").arg(formatSize(fileSize)));
+    } else {
+        emit logMessage("📊 Taille du fichier inconnue: réception en continu jusqu'à la fin");
+    }
+    if (!rangesSupported) {
+        emit logMessage("⚠ Le serveur ne gère pas les requêtes partielles: une seule connexion, sans reprise possible");
+    } else if (singleStream) {
+        emit logMessage("📦 Petit fichier: une seule connexion");
+    } else if (fixedConnections > 0) {
+        emit logMessage(QString("🚀 Démarrage avec %1 connexions parallèles...").arg(desiredConnections));
+    } else {
+        emit logMessage(QString("🚀 Démarrage avec %1 connexions (ajustement automatique jusqu'à %2)...")
+                            .arg(desiredConnections).arg(tuner.maximum()));
+    }
+
+    if (verifier->isEnabled() && fileSize >= 0 && !verifier->start(partPath, fileSize)) {
+        failDownload("❌ Erreur: les empreintes des segments ne correspondent pas à la taille du fichier",
+                     "Les empreintes fournies ne correspondent pas à la taille du fichier.");
+        return;
+    }
+
+    outputFile = std::make_shared<OutputFile>();
+    if (!outputFile->open(partPath, qMax<qint64>(fileSize, 0), resume)) {
+        QString error = outputFile->errorString();
+        failDownload("❌ Erreur: Impossible de créer le fichier", "Impossible de créer le fichier: " + error);
+        return;
+    }
+
+    receivedBytes.storeRelaxed(journal.completed().totalLength());
+    lastBytesReceived = receivedBytes.loadRelaxed();
+    if (resume) {
+        emit logMessage(QString("♻ Reprise: %1 déjà téléchargés").arg(formatSize(lastBytesReceived)));
+    }
+
+    startTime = QTime::currentTime();
+
+    // The probe keeps the first slice; it already has the start of it in flight.
+    QList<ByteRange> missing = fileSize >= 0 ? journal.completed().missing(fileSize)
+                                             : QList<ByteRange>{{0, DownloadThread::OpenEnd}};
+    // Extraction and the stream read the file from its start: slices are
+    // handed out in order, and no further than the window ahead of the stream.
+    bool streaming = !streamTarget.isEmpty();
+    bool frontFirst = (streaming || !extractDirectory.isEmpty()) && fileSize >= 0 && !singleStream;
+    qint64 slice = 0;
+    if (frontFirst) {
+        slice = qBound(FrontSliceMin, fileSize / (desiredConnections * 8), FrontSliceMax);
+        if (streaming && streamWindow > 0) {
+            slice = qMin(slice, qMax(StreamSliceMin, streamWindow / (desiredConnections * 2)));
+        }
+    }
+    scheduler.setFrontFirst(slice);
+    scheduler.setWindow(frontFirst && streaming ? streamWindow : 0);
+    scheduler.reset(missing, singleStream ? 1 : desiredConnections);
+    SegmentScheduler::Range range = scheduler.claim(id, start);
+    DownloadThread *thread = threads[id];
+    thread->shrinkEnd(range.end);
+    threadPercentages[id] = 0;
+    emit threadProgressUpdated(id, 0);
+    emit logMessage(QString("✅ Thread %1 démarré: %2 - %3").arg(id).arg(range.start)
+                        .arg(fileSize >= 0 ? QString::number(range.end) : QString("fin")));
+
+    // Workers created to preconnect predate the file and its validator, as
+    // the probe's later requests do: they all get them before any range.
+    OutputFile *output = outputFile.get();
+    for (DownloadThread *worker : threads) {
+        QMetaObject::invokeMethod(worker, [worker, output, rangesSupported, validator]() {
+            worker->setValidator(validator);
+            worker->attachOutput(output, rangesSupported);
+        }, Qt::QueuedConnection);
+    }
+
+    if (!extractDirectory.isEmpty()) {
+        emit logMessage(QString("📦 Extraction au fil du téléchargement dans %1").arg(extractDirectory));
+        extractor->start(partPath, extractDirectory, extractedName());
+    }
+    if (streaming) {
+        emit logMessage(QString("📤 Envoi dans l'ordre vers %1 pendant le téléchargement")
+                            .arg(streamTarget == "-" ? QString("la sortie standard") : streamTarget));
+        streamer->start(partPath, streamTarget);
+    }
+
+    if (rangesSupported) {
+        writeJournal(journal.completed());
+        journalTimer->start(JournalIntervalMs);
+    }
+    speedTimer->start(1000);
+    progressTimer->start();
+
+    for (int i = 0; i < mirrors.size(); ++i) {
+        checkMirror(i);
+    }
+    updateConnectionTarget();
+
+    // Resumed bytes are checked like fresh ones.
+    if (fileSize >= 0) {
+        verifier->update(journal.completed());
+    }
+}
+
+void DownloadManager::onNotModified(int id) {
+    Q_UNUSED(id);
+    trace.instant(TraceRecorder::DownloadTrack, "not modified");
+    abortHeadRequests();
+    releaseWorkers();
+    emit logMessage("♻ Inchangé sur le serveur (304): copie depuis le cache");
+    serveFromCache(cached.digest);
+}
+
+void DownloadManager::serveFromCache(const QByteArray &digest) {
+    // Reflinks and hard links are instant, a plain copy is not: off this thread.
+    ContentCache *source = cache;
+    QString destination = fileSavePath;
+    int generation = taskGeneration;
+    fileTasks.start([this, source, digest, destination, generation]() {
+        QString error;
+        bool success = source->materialize(digest, destination, &error);
+        QMetaObject::invokeMethod(this, [=]() {
+            onCacheServed(generation, success, error);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void DownloadManager::onCacheServed(int generation, bool success, const QString &error) {
+    if (generation != taskGeneration) {
+        return;
+    }
+    if (!success) {
+        // Evicted in the meantime, or the destination is not writable: the
+        // download proper reports the latter.
+        emit logMessage("⚠ Copie depuis le cache impossible (" + error + "): téléchargement complet");
+        cacheBypass = true;
+        startDownload(fileUrl, fileSavePath);
+        return;
+    }
+
+    fileSize = QFileInfo(fileSavePath).size();
+    emit fileSizeReceived(formatSize(fileSize));
+    emit progressUpdated(100);
+    emit logMessage(QString("✅ Fichier écrit depuis le cache: %1").arg(fileSavePath));
+    // Nothing to overlap with: the whole file is read at once.
+    if (!extractDirectory.isEmpty()) {
+        emit logMessage(QString("📦 Extraction dans %1...").arg(extractDirectory));
+        processingCached = true;
+        extractor->start(fileSavePath, extractDirectory, extractedName());
+        extractor->finishInput(fileSize);
+    }
+    if (!streamTarget.isEmpty()) {
+        processingCached = true;
+        streamer->start(fileSavePath, streamTarget);
+        streamer->finishInput(fileSize);
+    }
+    if (processingCached) {
+        return;
+    }
+    emit downloadFinished(true, QString("Fichier à jour, copié depuis le cache.\n\nFichier: %1\nTaille: %2")
+                                    .arg(fileSavePath)
+                                    .arg(formatSize(fileSize)));
+}
+
+void DownloadManager::storeInCache() {
+    // Hashing takes a while on a large file: the download is reported
+    // finished without waiting. A verified SHA-256 spares the hashing.
+    ContentCache *target = cache;
+    QString url = fileUrl;
+    QByteArray validator = fileValidator;
+    QString path = fileSavePath;
+    QByteArray digest = expectedSha256;
+    fileTasks.start([this, target, url, validator, path, digest]() {
+        QString error;
+        if (!target->store(url, validator, path, digest, &error)) {
+            QMetaObject::invokeMethod(this, [this, error]() {
+                emit logMessage("⚠ Fichier non ajouté au cache: " + error);
+            }, Qt::QueuedConnection);
+        }
+    });
+}
+
+void DownloadManager::onChunkDownloaded(int id) {
+    // Lost a race but got to the end before hearing about it.
+    if (scheduler.isCancelled(id)) {
+        onChunkAbandoned(id);
+        return;
+    }
+
+    int loser;
+    SegmentScheduler::Range range = scheduler.finish(id, &loser);
+    qint64 segmentEnd = trace.now();
+    if (loser >= 0) {
+        emit logMessage(QString("🏁 Thread %1 a fini avant le thread %2, qui abandonne sa copie").arg(id).arg(loser));
+        trace.instant(id + 1, "race won", {{"loser", loser}});
+        QMetaObject::invokeMethod(threads[loser], &DownloadThread::abandon, Qt::QueuedConnection);
+    }
+    if (fileSize < 0) {
+        // The stream has ended: only now is the size known.
+        fileSize = range.start + threads[id]->received();
+        range.end = fileSize - 1;
+        emit fileSizeReceived(formatSize(fileSize));
+        if (verifier->isEnabled() && !verifier->start(fileSavePath + ".part", fileSize)) {
+            failDownload("❌ Erreur: les empreintes des segments ne correspondent pas à la taille du fichier",
+                         "Les empreintes fournies ne correspondent pas à la taille du fichier.");
+            return;
+        }
+    }
+    journal.completed().add(range.start, range.end);
+    trace.span(id + 1, "segment", traceSamples[id].segmentStart, segmentEnd,
+               {{"start", range.start}, {"end", range.end}, {"bytes", range.end - range.start + 1},
+                {"mirror", mirrors[workerMirror[id]]->url}});
+
+    emit logMessage(QString("✅ Thread %1 a terminé %2 - %3").arg(id).arg(range.start).arg(range.end));
+    threadPercentages[id] = 100;
+    emit threadProgressUpdated(id, 100);
+
+    // A retired worker only picks up work nobody else is left to do, unless
+    // the download has no connections allowed at all.
+    if (!retired[id] || (scheduler.activeCount() == 0 && numThreads > 0)) {
+        assignNextRange(id);
+    }
+
+    verifier->update(journal.completed());
+    completeIfDone();
+}
+
+void DownloadManager::onChunkAbandoned(int id) {
+    syncProgress();
+    qint64 duplicate;
+    SegmentScheduler::Range own = scheduler.abandon(id, duplicate);
+    if (own.end >= own.start) {
+        journal.completed().add(own.start, own.end);
+    }
+    // Counted twice: by this worker and by the copy that carries on or won.
+    receivedBytes.fetchAndSubRelaxed(duplicate);
+
+    threadPercentages[id] = 100;
+    emit threadProgressUpdated(id, 100);
+    if (!retired[id]) {
+        assignNextRange(id);
+    }
+    verifier->update(journal.completed());
+    completeIfDone();
+}
+
+void DownloadManager::completeIfDone() {
+    if (!bufferPool || probing || scheduler.activeCount() > 0 || scheduler.hasPending()) {
+        return;
+    }
+    speedTimer->stop();
+    progressTimer->stop();
+
+    if (verifier->isEnabled() && !verifier->isFinished()) {
+        emit logMessage("🔎 Vérification de l'intégrité des derniers segments...");
+        return;
+    }
+    bool waiting = false;
+    if (extractor->isRunning() && !extractor->isFinished()) {
+        if (!extractor->isInputComplete()) {
+            emit logMessage("📦 Extraction des dernières données...");
+            extractor->finishInput(fileSize);
+        }
+        waiting = true;
+    }
+    if (streamer->isRunning() && !streamer->isFinished()) {
+        if (!streamer->isInputComplete()) {
+            emit logMessage("📤 Envoi des dernières données...");
+            streamer->finishInput(fileSize);
+        }
+        waiting = true;
+    }
+    if (!waiting) {
+        finalizeFile();
+    }
+}
+
+void DownloadManager::onPieceFailed(qint64 start, qint64 end) {
+    trace.instant(TraceRecorder::DownloadTrack, "corrupt piece", {{"start", start}, {"end", end}});
+    if (++pieceRetries[start] > maxRetries) {
+        journal.completed().remove(start, end);
+        failDownload(QString("❌ Segment %1 - %2 toujours corrompu après %3 tentatives").arg(start).arg(end).arg(maxRetries),
+                     "Le fichier reçu ne correspond pas à l'empreinte attendue.");
+        return;
+    }
+
+    emit logMessage(QString("⚠ Segment %1 - %2 corrompu (%3): nouveau téléchargement")
+                        .arg(start).arg(end).arg(formatSize(end - start + 1)));
+    journal.completed().remove(start, end);
+    receivedBytes.fetchAndAddRelaxed(-(end - start + 1));
+    scheduler.enqueue(start, end);
+    if (extractor->isRunning() && extractor->consumed() > start) {
+        // The extractor has read the bad bytes: it reads everything again.
+        emit logMessage("📦 Extraction reprise depuis le début");
+        extractionError.clear();
+        extractor->restart();
+    }
+    if (streamer->isRunning() && streamer->consumed() > start) {
+        dropStream(QString("les octets %1 - %2 déjà envoyés étaient corrompus").arg(start).arg(end));
+    }
+
+    if (!speedTimer->isActive()) {
+        speedTimer->start(1000);
+        progressTimer->start();
+    }
+    for (int i = 0; i < threads.size(); ++i) {
+        if (!retired[i] && !scheduler.isActive(i)) {
+            assignNextRange(i);
+        }
+    }
+}
+
+void DownloadManager::onVerificationFinished(bool success, const QString &message) {
+    if (!success) {
+        // The bytes on disk are wrong and nothing tells which: start over next time.
+        speedTimer->stop();
+        progressTimer->stop();
+        journalTimer->stop();
+        extractor->reset();
+        streamer->reset();
+        releaseWorkers();
+        outputFile.reset();
+        QFile::remove(fileSavePath + ".part");
+        removeJournal();
+
+        emit logMessage("❌ " + message);
+        QString restart;
+        if (!verifier->hasPieceDigests()) {
+            restart = "\n\nSans empreintes par segment (Metalink), les octets faux ne peuvent pas être retrouvés: "
+                      "le fichier partiel est supprimé et le prochain essai le téléchargera en entier.";
+            emit logMessage("⚠ Empreinte du fichier entier seulement: aucun segment à retélécharger seul, "
+                            "le fichier partiel est supprimé");
+        }
+        emit downloadFinished(false, "Le fichier téléchargé est corrompu.\n\n" + message + restart);
+        return;
+    }
+
+    emit logMessage("🔐 Intégrité vérifiée: " + message);
+    completeIfDone();
+}
+
+void DownloadManager::onExtractionFinished(bool success, const QString &message) {
+    // A failed extraction leaves the download itself to finish: the file is
+    // kept either way and the error reported with it.
+    if (success) {
+        emit logMessage("📦 Extraction terminée: " + message);
+    } else {
+        extractionError = message;
+        emit logMessage("❌ Extraction impossible: " + message);
+    }
+    if (processingCached) {
+        finishCachedCopy();
+    } else {
+        completeIfDone();
+    }
+}
+
+void DownloadManager::onStreamFinished(bool success, const QString &message) {
+    if (!success) {
+        dropStream(message);
+        return;
+    }
+    emit logMessage("📤 Envoi terminé: " + message);
+    if (processingCached) {
+        finishCachedCopy();
+    } else {
+        completeIfDone();
+    }
+}
+
+void DownloadManager::dropStream(const QString &error) {
+    streamError = error;
+    streamer->reset();
+    emit logMessage("❌ Envoi interrompu: " + error);
+    if (processingCached) {
+        finishCachedCopy();
+        return;
+    }
+    // Workers held back by the window carry on with the rest of the file.
+    scheduler.setWindow(0);
+    if (!paused) {
+        for (int i = 0; i < threads.size(); ++i) {
+            if (!retired[i] && !scheduler.isActive(i)) {
+                assignNextRange(i);
+            }
+        }
+    }
+    completeIfDone();
+}
+
+void DownloadManager::finishCachedCopy() {
+    if ((extractor->isRunning() && !extractor->isFinished()) || (streamer->isRunning() && !streamer->isFinished())) {
+        return;
+    }
+    processingCached = false;
+    QString error = !extractionError.isEmpty() ? "son extraction a échoué: " + extractionError
+                  : !streamError.isEmpty() ? "son envoi a échoué: " + streamError : QString();
+    if (!error.isEmpty()) {
+        emit downloadFinished(false, QString("Fichier copié depuis le cache, mais %1\n\nFichier: %2")
+                                         .arg(error)
+                                         .arg(fileSavePath));
+        return;
+    }
+    emit downloadFinished(true, QString("Fichier à jour, copié depuis le cache.\n\nFichier: %1\nTaille: %2")
+                                    .arg(fileSavePath)
+                                    .arg(formatSize(fileSize)));
+}
+
+int DownloadManager::addWorker() {
+    // Wake a retired worker before creating a new one.
+    for (int i = 0; i < threads.size(); ++i) {
+        if (retired[i] && !scheduler.isActive(i)) {
+            retired[i] = false;
+            return i;
+        }
+    }
+
+    int id = threads.size();
+    IoThreadPool *pool = IoThreadPool::instance();
+    QThread *ioThread;
+    if (protocol == Http2 && id >= http2Connections) {
+        // Streams only share a connection inside one transport, so later
+        // workers join the threads of the first ones.
+        ioThread = ioThreads[id % http2Connections];
+        pool->acquire(ioThread);
+    } else {
+        ioThread = pool->acquire();
+    }
+    DownloadThread *thread = new DownloadThread(id, outputFile.get(), bufferPool, pool->transport(ioThread, backend));
+    thread->setValidator(fileValidator);
+    thread->setMaxRetries(maxRetries);
+    thread->setRateLimiter(&rateLimiter);
+    thread->setProgressCounter(&receivedBytes);
+    thread->setHttp2(protocol == Http2, http2Configuration);
+    thread->setTrace(traceFile.isEmpty() ? nullptr : &trace);
+    trace.setTrackName(id + 1, QString("thread %1").arg(id));
+    threads.append(thread);
+    retired.append(false);
+    traceSamples.append(TraceSample());
+    threadPercentages.append(0);
+    workerMirror.append(-1);
+
+    connect(thread, &DownloadThread::chunkDownloaded, this, &DownloadManager::onChunkDownloaded);
+    connect(thread, &DownloadThread::chunkAbandoned, this, &DownloadManager::onChunkAbandoned);
+    connect(thread, &DownloadThread::chunkError, this, &DownloadManager::onChunkError);
+    connect(thread, &DownloadThread::writeFailed, this, &DownloadManager::onWriteFailed);
+    connect(thread, &DownloadThread::remoteFileChanged, this, &DownloadManager::onRemoteFileChanged);
+    connect(thread, &DownloadThread::chunkRetrying, this, &DownloadManager::onChunkRetrying);
+    connect(thread, &DownloadThread::probed, this, &DownloadManager::onProbed);
+    connect(thread, &DownloadThread::notModified, this, &DownloadManager::onNotModified);
+
+    thread->moveToThread(ioThread);
+    ioThreads.append(ioThread);
+
+    emit threadCountChanged(threads.size());
+    return id;
+}
+
+void DownloadManager::retireWorker() {
+    for (int i = threads.size() - 1; i >= 0; --i) {
+        if (retired[i]) {
+            continue;
+        }
+        retired[i] = true;
+
+        // Hand the rest of its range back so the remaining workers pick it up.
+        qint64 end = scheduler.release(i, RetireKeepBytes);
+        if (end >= 0) {
+            threads[i]->shrinkEnd(end);
+        }
+        return;
+    }
+}
+
+void DownloadManager::applyConnectionTarget(int target) {
+    if (target == numThreads) {
+        return;
+    }
+    if (numThreads > 0) {
+        emit logMessage(QString("⚙ Connexions: %1 → %2").arg(numThreads).arg(target));
+    }
+
+    while (numThreads < target) {
+        addWorker();
+        numThreads++;
+    }
+    while (numThreads > target) {
+        retireWorker();
+        numThreads--;
+    }
+
+    for (int i = 0; i < threads.size(); ++i) {
+        if (!retired[i] && !scheduler.isActive(i)) {
+            assignNextRange(i);
+        }
+    }
+}
+
+void DownloadManager::updateConnectionTarget() {
+    // Fan-out waits for the probe; workers are gone once the download ends.
+    if (!bufferPool || probing) {
+        return;
+    }
+    // A single stream cannot be parked: without Range it could not continue.
+    applyConnectionTarget(singleStream ? 1 : qMin(desiredConnections, connectionAllowance));
+}
+
+void DownloadManager::assignNextRange(int id) {
+    // Stealing picks its victim from up-to-date progress.
+    syncProgress();
+
+    SegmentScheduler::Range range;
+    int victim;
+    int original = -1;
+    if (!scheduler.next(id, range, victim)) {
+        // Nothing left to split: race a straggler for its tail. A single
+        // stream may have no Range support to fetch a tail with.
+        if (singleStream || paused || !scheduler.hedge(id, endgameBytes, stragglerRatio, range, original)) {
+            return;
+        }
+    }
+
+    if (original >= 0) {
+        emit logMessage(QString("🏁 Thread %1 double la fin du thread %2: %3 - %4 (%5)")
+                            .arg(id).arg(original).arg(range.start).arg(range.end).arg(formatSize(range.length())));
+        trace.instant(id + 1, "hedge", {{"original", original}, {"start", range.start}, {"end", range.end}});
+    } else if (victim >= 0) {
+        threads[victim]->shrinkEnd(range.start - 1);
+        emit logMessage(QString("🔀 Thread %1 reprend la fin du thread %2: %3 - %4 (%5)")
+                            .arg(id).arg(victim).arg(range.start).arg(range.end).arg(formatSize(range.length())));
+    } else {
+        emit logMessage(QString("✅ Thread %1 démarré: %2 - %3 (%4)")
+                            .arg(id).arg(range.start).arg(range.end).arg(formatSize(range.length())));
+    }
+
+    // A copy of a tail goes to another mirror when there is one.
+    int mirror = pickMirror(original >= 0 ? workerMirror[original] : -1);
+    workerMirror[id] = mirror;
+    if (liveMirrorCount() > 1) {
+        emit logMessage(QString("🪞 Thread %1 → %2").arg(id).arg(mirrors[mirror]->url));
+    }
+
+    DownloadThread *thread = threads[id];
+    thread->setRange(range.start, range.end);
+    thread->setSource(mirrors[mirror]->url, &mirrors[mirror]->bytes);
+    traceSamples[id].segmentStart = trace.now();
+    QMetaObject::invokeMethod(thread, &DownloadThread::start, Qt::QueuedConnection);
+    threadPercentages[id] = 0;
+    emit threadProgressUpdated(id, 0);
+}
+
+void DownloadManager::onChunkError(int id, const QString &error) {
+    if (probing) {
+        failDownload("❌ Erreur: " + error, "Impossible de récupérer les informations du fichier: " + error);
+        return;
+    }
+    // The other copy of the tail finishes it, or already has.
+    if (scheduler.isCancelled(id) || scheduler.isRacing(id)) {
+        emit logMessage(QString("⚠ Thread %1 abandonne sa copie: %2").arg(id).arg(error));
+        onChunkAbandoned(id);
+        return;
+    }
+    // Another mirror can finish the segment.
+    if (liveMirrorCount() > 1) {
+        dropMirror(workerMirror[id], error);
+        return;
+    }
+    failDownload(QString("❌ Erreur thread %1 (tentatives épuisées): %2").arg(id).arg(error),
+                 QString("Erreur lors du téléchargement: %1").arg(error));
+}
+
+void DownloadManager::onWriteFailed(int id, const QString &error) {
+    // A full or failing disk: every mirror would write to the same file.
+    failDownload(QString("❌ Erreur d'écriture thread %1: %2").arg(id).arg(error),
+                 QString("Impossible d'écrire le fichier: %1").arg(error));
+}
+
+void DownloadManager::onChunkRetrying(int id, int attempt, int delayMs, const QString &error) {
+    tuner.recordError();
+    emit logMessage(QString("🔁 Thread %1: %2 — nouvelle tentative %3/%4 dans %5 ms")
+                        .arg(id).arg(error).arg(attempt).arg(maxRetries).arg(delayMs));
+    trace.instant(id + 1, "retry", {{"attempt", attempt}, {"delayMs", delayMs}, {"error", error}});
+
+    int mirror = workerMirror[id];
+    if (++mirrors[mirror]->failures >= MirrorMaxFailures && liveMirrorCount() > 1) {
+        dropMirror(mirror, QString("%1 échecs sans données").arg(mirrors[mirror]->failures));
+    }
+}
+
+void DownloadManager::onRemoteFileChanged(int id) {
+    if (scheduler.isCancelled(id)) {
+        onChunkAbandoned(id);
+        return;
+    }
+    // Only this mirror changed, or never matched: keep going with the others.
+    if (liveMirrorCount() > 1) {
+        dropMirror(workerMirror[id], "le fichier y a changé");
+        return;
+    }
+
+    speedTimer->stop();
+    progressTimer->stop();
+    journalTimer->stop();
+    verifier->reset();
+    extractor->reset();
+    streamer->reset();
+    releaseWorkers();
+    outputFile.reset();
+
+    // The bytes on disk belong to the old version: never resume from them.
+    removeJournal();
+
+    emit logMessage(QString("❌ Thread %1: le fichier distant a changé pendant le téléchargement").arg(id));
+    emit downloadFinished(false, "Le fichier a été modifié sur le serveur. Relancez le téléchargement pour repartir de zéro.");
+}
+
+int DownloadManager::connectionsOn(int mirror) const {
+    int count = 0;
+    for (int i = 0; i < workerMirror.size(); ++i) {
+        if (workerMirror[i] == mirror && scheduler.isActive(i)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+int DownloadManager::liveMirrorCount() const {
+    int count = 0;
+    for (const Mirror *mirror : mirrors) {
+        if (mirror->verified && !mirror->dropped) {
+            count++;
+        }
+    }
+    return count;
+}
+
+int DownloadManager::pickMirror(int avoid) const {
+    // A mirror not measured yet is assumed as fast as the best one, so it gets tried.
+    double bestRate = 0;
+    for (const Mirror *mirror : mirrors) {
+        if (mirror->verified && !mirror->dropped) {
+            bestRate = qMax(bestRate, mirror->connectionRate);
+        }
+    }
+
+    // Connections are shared in proportion to speed per connection: take the
+    // mirror that would have the fewest connections per unit of speed.
+    int best = 0;
+    double bestLoad = std::numeric_limits<double>::max();
+    for (int i = 0; i < mirrors.size(); ++i) {
+        if (!mirrors[i]->verified || mirrors[i]->dropped || (i == avoid && liveMirrorCount() > 1)) {
+            continue;
+        }
+        double weight = mirrors[i]->connectionRate > 0 ? mirrors[i]->connectionRate : qMax(bestRate, 1.0);
+        double load = (connectionsOn(i) + 1) / weight;
+        if (load < bestLoad) {
+            bestLoad = load;
+            best = i;
+        }
+    }
+    return best;
+}
+
+void DownloadManager::dropMirror(int mirror, const QString &reason) {
+    mirrors[mirror]->dropped = true;
+    emit logMessage(QString("🪞 Miroir abandonné (%1): %2").arg(reason, mirrors[mirror]->url));
+    trace.instant(TraceRecorder::DownloadTrack, "mirror dropped", {{"url", mirrors[mirror]->url}, {"reason", reason}});
+
+    // Segments in flight on it continue from where they are on another mirror.
+    for (int i = 0; i < threads.size(); ++i) {
+        if (workerMirror[i] != mirror || !scheduler.isActive(i) || scheduler.isCancelled(i)) {
+            continue;
+        }
+        int target = pickMirror();
+        workerMirror[i] = target;
+        DownloadThread *thread = threads[i];
+        QString url = mirrors[target]->url;
+        QAtomicInteger<qint64> *bytes = &mirrors[target]->bytes;
+        QMetaObject::invokeMethod(thread, [thread, url, bytes]() {
+            thread->switchSource(url, bytes);
+        }, Qt::QueuedConnection);
+    }
+}
+
+void DownloadManager::updateMirrorRates() {
+    if (mirrors.size() < 2) {
+        return;
+    }
+
+    double bestRate = 0;
+    for (int i = 0; i < mirrors.size(); ++i) {
+        Mirror *mirror = mirrors[i];
+        qint64 bytes = mirror->bytes.loadRelaxed();
+        qint64 delta = bytes - mirror->lastBytes;
+        mirror->lastBytes = bytes;
+        if (delta > 0) {
+            mirror->failures = 0;
+        }
+
+        int connections = connectionsOn(i);
+        if (mirror->dropped || connections == 0 || paused) {
+            continue;
+        }
+        double rate = double(delta) / connections;
+        mirror->connectionRate = mirror->connectionRate > 0 ? 0.7 * mirror->connectionRate + 0.3 * rate : rate;
+        bestRate = qMax(bestRate, mirror->connectionRate);
+    }
+
+    for (int i = 0; i < mirrors.size() && liveMirrorCount() > 1; ++i) {
+        Mirror *mirror = mirrors[i];
+        if (mirror->dropped || connectionsOn(i) == 0) {
+            continue;
+        }
+        mirror->slowSamples = mirror->connectionRate < bestRate * SlowMirrorRatio ? mirror->slowSamples + 1 : 0;
+        if (mirror->slowSamples >= SlowMirrorSamples) {
+            dropMirror(i, QString("%1/s par connexion").arg(formatSize(qint64(mirror->connectionRate))));
+        }
+    }
+}
+
+void DownloadManager::saveJournal() {
+    if (!outputFile) {
+        return;
+    }
+
+    // Only record bytes once they are on stable storage: the ranges are taken
+    // before the sync, so all of them are there once it returns. The sync can
+    // take seconds on a busy disk, hence off this thread.
+    syncProgress();
+    RangeSet ranges = bytesOnDisk();
+    DownloadJournal snapshot = journal;
+    std::shared_ptr<OutputFile> output = outputFile;
+    int epoch = journalEpoch.fetchAndAddRelaxed(1) + 1;
+    int generation = taskGeneration;
+    fileTasks.start([this, snapshot, ranges, output, epoch, generation]() mutable {
+        // A later save syncs the same file again.
+        if (journalEpoch.loadRelaxed() != epoch) {
+            return;
+        }
+        qint64 flushStart = trace.now();
+        bool synced = output->sync();
+        qint64 flushEnd = trace.now();
+        if (synced) {
+            QMutexLocker locker(&journalMutex);
+            if (journalEpoch.loadRelaxed() == epoch) {
+                snapshot.save(ranges);
+            }
+        }
+        QMetaObject::invokeMethod(this, [=]() {
+            onJournalSaved(generation, flushStart, flushEnd);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void DownloadManager::onJournalSaved(int generation, qint64 flushStart, qint64 flushEnd) {
+    if (generation != taskGeneration) {
+        return;
+    }
+    trace.span(TraceRecorder::DownloadTrack, "flush", flushStart, flushEnd);
+}
+
+void DownloadManager::writeJournal(const RangeSet &ranges) {
+    QMutexLocker locker(&journalMutex);
+    journalEpoch.fetchAndAddRelaxed(1);
+    journal.save(ranges);
+}
+
+void DownloadManager::removeJournal() {
+    QMutexLocker locker(&journalMutex);
+    journalEpoch.fetchAndAddRelaxed(1);
+    journal.remove();
+}
+
+RangeSet DownloadManager::bytesOnDisk() {
+    RangeSet done = journal.completed();
+    for (int i = 0; i < threads.size(); ++i) {
+        qint64 received = scheduler.receivedOf(i);
+        if (received > 0) {
+            SegmentScheduler::Range range = scheduler.rangeOf(i);
+            done.add(range.start, range.start + received - 1);
+        }
+    }
+    return done;
+}
+
+QString DownloadManager::extractedName() const {
+    QString name = QFileInfo(fileSavePath).fileName();
+    QString suffix = QFileInfo(name).suffix().toLower();
+    if (suffix == "tgz" || suffix == "txz") {
+        name = QFileInfo(name).completeBaseName() + ".tar";
+    } else if (suffix == "gz" || suffix == "xz") {
+        name = QFileInfo(name).completeBaseName();
+    }
+    // Never the downloaded file itself.
+    if (QDir(extractDirectory).absoluteFilePath(name) == QFileInfo(fileSavePath).absoluteFilePath()) {
+        name += ".out";
+    }
+    return name;
+}
+
+void DownloadManager::syncProgress() {
+    for (int i = 0; i < threads.size(); ++i) {
+        scheduler.updateProgress(i, threads[i]->received());
+    }
+}
+
+void DownloadManager::publishProgress() {
+    syncProgress();
+
+    // Duplicate bytes of a stolen tail may push the sum slightly past the size.
+    qint64 totalReceived = receivedBytes.loadRelaxed();
+    if (fileSize >= 0) {
+        totalReceived = qMin(totalReceived, fileSize);
+    }
+    int percentage = (fileSize > 0) ? (totalReceived * 100 / fileSize) : 0;
+    if (percentage != lastPercentage) {
+        lastPercentage = percentage;
+        emit progressUpdated(percentage);
+    }
+
+    for (int i = 0; i < threads.size(); ++i) {
+        if (!scheduler.isActive(i)) {
+            continue;
+        }
+        qint64 length = scheduler.rangeOf(i).length();
+        int threadPercentage = (length > 0) ? int(scheduler.receivedOf(i) * 100 / length) : 0;
+        if (threadPercentage != threadPercentages[i]) {
+            threadPercentages[i] = threadPercentage;
+            emit threadProgressUpdated(i, threadPercentage);
+        }
+    }
+
+    feedPrefixReaders();
+}
+
+void DownloadManager::feedPrefixReaders() {
+    if (!extractor->isRunning() && !streamer->isRunning()) {
+        return;
+    }
+    QList<ByteRange> ranges = bytesOnDisk().ranges();
+    if (!ranges.isEmpty() && ranges.first().start == 0) {
+        extractor->update(ranges.first().end + 1);
+        streamer->update(ranges.first().end + 1);
+    }
+    if (!streamer->isRunning()) {
+        return;
+    }
+
+    // The reader took more: workers held back by the window move on.
+    scheduler.setCursor(streamer->written());
+    if (paused || !scheduler.hasPending()) {
+        return;
+    }
+    for (int i = 0; i < threads.size(); ++i) {
+        if (!retired[i] && !scheduler.isActive(i)) {
+            assignNextRange(i);
+        }
+    }
+}
+
+void DownloadManager::updateSpeed() {
+    qint64 totalReceived = receivedBytes.loadRelaxed();
+    if (fileSize >= 0) {
+        totalReceived = qMin(totalReceived, fileSize);
+    }
+
+    qint64 bytesPerSecond = totalReceived - lastBytesReceived;
+    lastBytesReceived = totalReceived;
+
+    emit speedUpdated(formatSize(bytesPerSecond) + "/s");
+    emit transferStats(totalReceived, fileSize, bytesPerSecond);
+
+    updateMirrorRates();
+    if (trace.isRunning()) {
+        sampleTrace(false);
+    }
+
+    // A straggler may only show up once the other workers have gone idle.
+    if (!scheduler.hasPending()) {
+        for (int i = 0; i < threads.size(); ++i) {
+            if (!retired[i] && !scheduler.isActive(i)) {
+                assignNextRange(i);
+            }
+        }
+    }
+
+    if (fixedConnections == 0 && !paused) {
+        int desired = tuner.sample(bytesPerSecond, desiredConnections);
+        if (desired != desiredConnections) {
+            desiredConnections = desired;
+            emit connectionDemandChanged(desiredConnections);
+            updateConnectionTarget();
+        }
+    }
+}
+
+void DownloadManager::sampleTrace(bool final) {
+    qint64 now = trace.now();
+    qint64 previous = lastTraceSample;
+    lastTraceSample = now;
+    double seconds = qMax<qint64>(1, now - previous) / 1e6;
+
+    qint64 total = 0;
+    for (int i = 0; i < threads.size(); ++i) {
+        TraceSample &sample = traceSamples[i];
+        qint64 transferred = threads[i]->transferred();
+        qint64 delta = transferred - sample.transferred;
+        sample.transferred = transferred;
+        total += delta;
+        qint64 writeNanos = threads[i]->writeTime();
+        traceWriteNanos += writeNanos - sample.writeNanos;
+        sample.writeNanos = writeNanos;
+
+        bool active = scheduler.isActive(i);
+        if (active) {
+            trace.counter("throughput MB/s", QString("thread %1").arg(i), delta / seconds / (1024 * 1024));
+        }
+
+        // A stall is a run of samples without a byte on an active segment.
+        bool stalled = active && !paused && !final && delta == 0;
+        if (stalled && sample.stallSince < 0) {
+            sample.stallSince = previous;
+        } else if (!stalled && sample.stallSince >= 0) {
+            if (now - sample.stallSince >= TraceStallUs) {
+                trace.span(i + 1, "stall", sample.stallSince, now);
+            }
+            sample.stallSince = -1;
+        }
+    }
+
+    trace.counter("throughput MB/s", "total", total / seconds / (1024 * 1024));
+    trace.counter("connections", "active", scheduler.activeCount());
+    trace.counter("disk write ms", "total", traceWriteNanos / 1e6);
+}
+
+void DownloadManager::finishTrace() {
+    if (!trace.isRunning()) {
+        return;
+    }
+
+    QJsonObject summary = trace.summary();
+    summary.insert("url", fileUrl);
+    summary.insert("bytes", fileSize);
+    summary.insert("diskWriteMs", traceWriteNanos / 1e6);
+    trace.stop();
+
+    QString error;
+    if (!trace.write(traceFile, summary, &error)) {
+        emit logMessage(QString("⚠ Trace non écrite (%1): %2").arg(traceFile, error));
+        return;
+    }
+
+    QJsonObject spans = summary.value("spans").toObject();
+    auto median = [&spans](const char *name) {
+        return QString::number(spans.value(name).toObject().value("p50Ms").toDouble(), 'f', 0);
+    };
+    QJsonObject events = summary.value("events").toObject();
+    emit logMessage(QString("📈 Trace: DNS %1 ms, connexion %2 ms, premier octet %3 ms (médianes), "
+                            "%4 tentative(s), %5 blocage(s), disque %6 ms → %7")
+                        .arg(median("dns"), median("connect"), median("ttfb"))
+                        .arg(events.value("retry").toInt())
+                        .arg(spans.value("stall").toObject().value("count").toInt())
+                        .arg(summary.value("diskWriteMs").toDouble(), 0, 'f', 0)
+                        .arg(traceFile));
+    emit traceWritten(traceFile, summary);
+}
+
+void DownloadManager::finalizeFile() {
+    journalTimer->stop();
+    releaseWorkers();
+
+    qint64 commitStart = trace.now();
+    bool committed = outputFile->commit(fileSavePath);
+    trace.span(TraceRecorder::DownloadTrack, "commit", commitStart, trace.now());
+    QString error = outputFile->errorString();
+    if (!committed) {
+        saveJournal();
+    }
+    outputFile.reset();
+
+    if (!committed) {
+        emit logMessage("❌ Erreur: Impossible de finaliser le fichier");
+        emit downloadFinished(false, "Impossible de finaliser le fichier: " + error);
+        return;
+    }
+    removeJournal();
+    if (cache) {
+        storeInCache();
+    }
+
+    int elapsed = startTime.secsTo(QTime::currentTime());
+    int minutes = elapsed / 60;
+    int seconds = elapsed % 60;
+
+    emit logMessage(QString("✅ Fichier écrit avec succès: %1").arg(fileSavePath));
+    emit logMessage(QString("⏱ Temps total: %1:%2").arg(minutes, 2, 10, QChar('0')).arg(seconds, 2, 10, QChar('0')));
+    QString postProcessError = !extractionError.isEmpty() ? "son extraction a échoué: " + extractionError
+                             : !streamError.isEmpty() ? "son envoi a échoué: " + streamError : QString();
+    if (!postProcessError.isEmpty()) {
+        emit downloadFinished(false, QString("Fichier téléchargé, mais %1\n\nFichier: %2")
+                                         .arg(postProcessError)
+                                         .arg(fileSavePath));
+        return;
+    }
+    emit downloadFinished(true, QString("Téléchargement terminé!\n\nFichier: %1\nTaille: %2\nTemps: %3:%4")
+                                    .arg(fileSavePath)
+                                    .arg(formatSize(fileSize))
+                                    .arg(minutes, 2, 10, QChar('0'))
+                                    .arg(seconds, 2, 10, QChar('0')));
+}
+
+QString DownloadManager::formatSize(qint64 bytes) {
+    if (bytes < 1024) return QString("%1 B").arg(bytes);
+    if (bytes < 1024 * 1024) return QString("%1 KB").arg(bytes / 1024.0, 0, 'f', 2);
+    if (bytes < 1024 * 1024 * 1024) return QString("%1 MB").arg(bytes / (1024.0 * 1024.0), 0, 'f', 2);
+    return QString("%1 GB").arg(bytes / (1024.0 * 1024.0 * 1024.0), 0, 'f', 2);
+}
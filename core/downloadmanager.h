@@ -0,0 +1,457 @@
+#ifndef DOWNLOADMANAGER_H
+#define DOWNLOADMANAGER_H
+
+#include <QObject>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QFile>
+#include <QHash>
+#include <QHttp2Configuration>
+#include <QMutex>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+#include <QTime>
+#include <QTimer>
+#include <QAtomicInteger>
+#include <limits>
+#include <memory>
+#include "connectiontuner.h"
+#include "contentcache.h"
+#include "downloadjournal.h"
+#include "integrityverifier.h"
+#include "prefixstreamer.h"
+#include "ratelimiter.h"
+#include "segmentscheduler.h"
+#include "streamextractor.h"
+#include "tracerecorder.h"
+#include "transport.h"
+#include "zsyncmanifest.h"
+
+class OutputFile;
+class BufferPool;
+class QThread;
+
+class DownloadThread : public QObject {
+    Q_OBJECT
+
+public:
+    // Range end while the file size is unknown; half the maximum so that
+    // range lengths never overflow.
+    static constexpr qint64 OpenEnd = std::numeric_limits<qint64>::max() / 2;
+
+    // Requests go through transport, owned by the I/O thread this worker is
+    // moved to. output may be null for a probe, see setProbe().
+    DownloadThread(int id, OutputFile *output, BufferPool *pool,
+                   Transport *transport, QObject *parent = nullptr);
+
+    // Called from the manager's thread while the worker is idle, before start().
+    void setRange(qint64 start, qint64 end);
+    // Safe to call at any time: the worker stops once it reaches the new end.
+    void shrinkEnd(qint64 end);
+    // Sent as If-Range so the server refuses to mix bytes of a changed file.
+    void setValidator(const QByteArray &value);
+    void setMaxRetries(int count);
+    void setRateLimiter(RateLimiter *limiter);
+    // Lets requests use HTTP/2 when the server offers it (TLS only). Off, every
+    // request keeps to HTTP/1.1 and its own connection.
+    void setHttp2(bool enabled, const QHttp2Configuration &configuration);
+    // The next response is the download's first: its headers are reported by
+    // probed() and its body waits in the reply until attachOutput().
+    void setProbe(bool enabled);
+    // Validator of a cached copy, sent with the probe as If-None-Match or
+    // If-Modified-Since; a 304 is reported by notModified().
+    void setConditional(const QByteArray &value);
+    // Every byte of the range written to disk is also added to total.
+    void setProgressCounter(QAtomicInteger<qint64> *total);
+    // Mirror the next range is fetched from; its bytes are also added to
+    // sourceBytes. Call while idle, like setRange().
+    void setSource(const QString &url, QAtomicInteger<qint64> *sourceBytes);
+    // Each request records its phases on track id + 1; null records nothing.
+    void setTrace(TraceRecorder *recorder);
+
+    // Bytes of the current range on disk; safe to read from any thread.
+    qint64 received() const;
+    // Totals since the worker was created, for sampling; safe from any thread.
+    qint64 transferred() const;
+    qint64 writeTime() const;   // ns spent in OutputFile::writeAt, when tracing
+
+public slots:
+    void start();
+    // Drops the connection but keeps the position; resume() re-requests the rest.
+    void pause();
+    void resume();
+    // Aborts the request for good, before the worker is deleted.
+    void stop();
+    // Drops the current request and carries on with the rest of the range
+    // from another mirror, also after chunkError or remoteFileChanged.
+    void switchSource(const QString &url, QAtomicInteger<qint64> *sourceBytes);
+    // Stops on the current range because another worker fetched it first;
+    // reported by chunkAbandoned unless the worker was already done.
+    void abandon();
+    // Opens a connection (TCP, and TLS for https) to the current source in
+    // this worker's transport, for its first request to reuse.
+    void preconnect();
+    // Lets a probe write its body. Without rangeRequests (server without Range
+    // support) a retry starts the whole range over.
+    void attachOutput(OutputFile *output, bool rangeRequests);
+
+signals:
+    void chunkDownloaded(int id);
+    void chunkAbandoned(int id);
+    void chunkError(int id, const QString &error);
+    // The output file could not be written: no other mirror would do better.
+    void writeFailed(int id, const QString &error);
+    void remoteFileChanged(int id);
+    void chunkRetrying(int id, int attempt, int delayMs, const QString &error);
+    // First response of a probe. size is -1 when the server does not say;
+    // start is where the body begins (0 if the server sent the whole file).
+    void probed(int id, qint64 start, qint64 size, const QByteArray &validator, bool rangesSupported);
+    void notModified(int id);
+
+private slots:
+    void sendRequest();
+    void onMetaDataChanged();
+    void onReadyRead();
+    void onThrottleTimeout();
+    void onFinished();
+
+private:
+    bool isTransientError() const;
+    void traceRequest();
+    void traceFinished();
+
+    int threadId;
+    QString downloadUrl;
+    qint64 startByte;
+    QAtomicInteger<qint64> endByte;
+    qint64 writeOffset;
+    QAtomicInteger<qint64> receivedBytes;
+    QAtomicInteger<qint64> *progressCounter;
+    QAtomicInteger<qint64> *sourceCounter;
+    QAtomicInteger<qint64> transferredBytes;
+    QAtomicInteger<qint64> writeNanos;
+    TraceRecorder *trace;
+    qint64 requestStart;
+    qint64 connectStart;
+    qint64 requestSent;
+    qint64 headersReceived;
+    OutputFile *outputFile;
+    BufferPool *bufferPool;
+    RateLimiter *rateLimiter;
+    QByteArray validator;
+    QByteArray conditional;
+    bool http2;
+    QHttp2Configuration http2Configuration;
+    QString writeError;
+    QString diskError;
+    bool validatorRejected;
+    bool probe;
+    bool waitingForOutput;
+    bool rangeRequests;
+    bool rangeRequested;
+    int maxRetries;
+    int attempts;
+    qint64 attemptOffset;
+    QTimer *retryTimer;
+    QTimer *throttleTimer;
+    bool active;
+    bool paused;
+    Transport *transport;
+    TransportReply *reply;
+};
+
+class DownloadManager : public QObject {
+    Q_OBJECT
+
+public:
+    enum Protocol {
+        Http1,      // one HTTP/1.1 connection per segment
+        Http2       // segments as concurrent streams over a few HTTP/2 connections
+    };
+
+    explicit DownloadManager(QObject *parent = nullptr);
+    ~DownloadManager();
+    void startDownload(const QString &url, const QString &savePath);
+
+    // Other URLs serving the same file as the one given to startDownload().
+    // Only mirrors whose size and ETag / Last-Modified match are used; segments
+    // then go to each in proportion to its speed per connection, and a mirror
+    // that keeps failing or is far slower than the others is dropped.
+    void setMirrors(const QStringList &urls);
+
+    // Bounds for the auto-tuned connection count.
+    void setConnectionLimits(int minimum, int maximum);
+    // A non-zero count disables auto-tuning and always runs that many connections.
+    void setFixedConnections(int count);
+    // Upper bound granted by a DownloadQueue sharing connections between
+    // downloads; 0 parks the download until connections are given back.
+    void setConnectionAllowance(int count);
+    // Connections this download would like to run with right now.
+    int connectionDemand() const;
+
+    // With Http2, the connection count set above is the number of concurrent
+    // streams, spread over the given number of connections per host. Windows
+    // are in bytes; 0 keeps Qt's default. Takes effect at the next startDownload().
+    void setProtocol(Protocol protocol);
+    void setHttp2Connections(int count);
+    void setHttp2Windows(qint32 streamWindow, qint32 sessionWindow);
+
+    // Endgame: an idle worker races a straggler for the unfinished tail of its
+    // segment once at most remainingBytes are left in flight, or when the
+    // segment runs below stragglerRatio times the median rate. The first copy
+    // to finish wins and the other is cancelled. 0 and 0 disable it.
+    void setEndgame(qint64 remainingBytes, double stragglerRatio);
+
+    // Consecutive failed attempts a segment may retry before the download fails.
+    void setMaxRetries(int count);
+
+    // Per-download cap in bytes per second, under the global one; 0 = unlimited.
+    // Both can be changed while a download runs.
+    void setRateLimit(qint64 bytesPerSecond);
+    static void setGlobalRateLimit(qint64 bytesPerSecond);
+
+    // Checks the file while it downloads; pieces that fail are fetched again.
+    // Takes effect at the next startDownload().
+    void setExpectedDigest(IntegrityVerifier::Algorithm algorithm, const QByteArray &digest);
+    void setPieceDigests(IntegrityVerifier::Algorithm algorithm, qint64 pieceLength, const QList<QByteArray> &digests);
+
+    // Progress signals are coalesced and published at most once per interval,
+    // whatever the transfer rate.
+    void setProgressInterval(int milliseconds);
+
+    // Records each download as a Chrome trace (DNS, connection, first byte,
+    // throughput, stalls, retries, disk time per segment) written to path when
+    // it ends; empty disables. Takes effect at the next startDownload().
+    void setTraceFile(const QString &path);
+
+    // While the probe waits for the size, the connections the download will
+    // start with are already opened, TLS included, so segments send their
+    // requests at once. Takes effect at the next startDownload().
+    void setPreconnect(bool enabled);
+
+    // HTTP engine of the workers; HEAD requests to mirrors always use Qt's.
+    // A backend this build lacks falls back to QtNetwork. Takes effect for
+    // workers created after the call, so set it before startDownload().
+    void setTransport(Transport::Backend backend);
+
+    // Finished files go into cache, which may be shared with other downloads;
+    // null disables. A cached URL is revalidated with a conditional request
+    // and copied from the cache if the server answers 304 Not Modified. With
+    // an expected SHA-256 already in the cache, nothing is requested at all.
+    void setCache(ContentCache *cache);
+
+    // Delta download: blocks of the new file found anywhere in seedPath (an
+    // older copy, usually the file being replaced) are copied locally and only
+    // the others are requested. Pair with the manifest's SHA-1 through
+    // setExpectedDigest(). An invalid manifest disables it.
+    void setDelta(const ZsyncManifest &manifest, const QString &seedPath);
+
+    // Decompresses (gzip, xz) and unpacks (tar) the file into directory while
+    // it downloads, from the start of the file as soon as it is on disk;
+    // segments are then handed out front first. The download only finishes
+    // once extraction has. Empty disables. Takes effect at the next startDownload().
+    void setExtraction(const QString &directory);
+
+    // Writes the file in order to target ("-" for stdout, or a FIFO) while it
+    // downloads, each byte once everything before it is on disk. Segments are
+    // handed out front first and at most window bytes past what the reader
+    // has taken (0 = no limit), which bounds what waits for it out of order.
+    // The file is still saved. Empty disables. Takes effect at the next startDownload().
+    void setStreamOutput(const QString &target, qint64 window);
+
+    void pause();
+    void resume();
+    bool isPaused() const;
+
+    // Aborts every request, stops and joins the workers and frees their
+    // buffers. The partial file and journal are kept for a later resume
+    // unless deletePartial is set.
+    void cancel(bool deletePartial = false);
+
+signals:
+    // progressUpdated and threadProgressUpdated are only emitted on change.
+    void progressUpdated(int percentage);
+    void downloadFinished(bool success, const QString &message);
+    void logMessage(const QString &message);
+    void threadProgressUpdated(int threadId, int percentage);
+    void speedUpdated(const QString &speed);
+    // Raw numbers behind progressUpdated/speedUpdated, once per second.
+    void transferStats(qint64 received, qint64 total, qint64 bytesPerSecond);
+    void fileSizeReceived(const QString &size);
+    void threadCountChanged(int count);
+    void connectionDemandChanged(int count);
+    // The trace was written; summary is the one stored in the file.
+    void traceWritten(const QString &path, const QJsonObject &summary);
+
+private slots:
+    void onChunkDownloaded(int id);
+    void onChunkAbandoned(int id);
+    void onChunkError(int id, const QString &error);
+    void onWriteFailed(int id, const QString &error);
+    void onRemoteFileChanged(int id);
+    void onChunkRetrying(int id, int attempt, int delayMs, const QString &error);
+    void onHeadFinished();
+    void onProbed(int id, qint64 start, qint64 size, const QByteArray &validator, bool rangesSupported);
+    void onNotModified(int id);
+    void updateSpeed();
+    void publishProgress();
+    void onPieceFailed(qint64 start, qint64 end);
+    void onVerificationFinished(bool success, const QString &message);
+    void onExtractionFinished(bool success, const QString &message);
+    void onStreamFinished(bool success, const QString &message);
+    void finishTrace();
+
+private:
+    int addWorker();
+    void retireWorker();
+    void applyConnectionTarget(int target);
+    void updateConnectionTarget();
+    void assignNextRange(int id);
+    // Syncs the file and writes the journal on fileTasks.
+    void saveJournal();
+    void onJournalSaved(int generation, qint64 flushStart, qint64 flushEnd);
+    // Write or remove the journal now, dropping any save still syncing.
+    void writeJournal(const RangeSet &ranges);
+    void removeJournal();
+    // Completed ranges plus what each worker has written of its own.
+    RangeSet bytesOnDisk();
+    // Name of a decompressed file that is not an archive.
+    QString extractedName() const;
+    // Feeds the contiguous prefix to the extractor and the stream, and moves
+    // the scheduler's window along with the stream.
+    void feedPrefixReaders();
+    // The stream cannot go on: the download does, without the window.
+    void dropStream(const QString &error);
+    // Ends a download served from the cache once its readers are done.
+    void finishCachedCopy();
+    void syncProgress();
+    void releaseWorkers();
+    void failDownload(const QString &log, const QString &message);
+    void completeIfDone();
+    // Prefers any other live mirror over avoid.
+    int pickMirror(int avoid = -1) const;
+    int connectionsOn(int mirror) const;
+    int liveMirrorCount() const;
+    void dropMirror(int mirror, const QString &reason);
+    void checkMirror(int mirror);
+    void updateMirrorRates();
+    void startTransfer(bool resumable);
+    void onSeedScanned(int generation, bool success, const RangeSet &reused, const QString &error);
+    void finalizeFile();
+    void abortHeadRequests();
+    void serveFromCache(const QByteArray &digest);
+    void onCacheServed(int generation, bool success, const QString &error);
+    void storeInCache();
+    void sampleTrace(bool final);
+    QString formatSize(qint64 bytes);
+
+    QString fileUrl;
+    QString fileSavePath;
+    qint64 fileSize;
+    QByteArray fileValidator;
+    int numThreads;
+    int fixedConnections;
+    int desiredConnections;
+    int connectionAllowance;
+    int maxRetries;
+    qint64 endgameBytes;
+    double stragglerRatio;
+    Protocol protocol;
+    int http2Connections;
+    QHttp2Configuration http2Configuration;
+    ConnectionTuner tuner;
+    RateLimiter rateLimiter;
+    bool paused;
+    // The first connection is still waiting for the response headers.
+    bool probing;
+    // Everything goes through one connection: no Range support, or a small file.
+    bool singleStream;
+    bool preconnect;
+    Transport::Backend backend;
+
+    struct Mirror {
+        QString url;
+        QAtomicInteger<qint64> bytes;   // written by the workers fetching from it
+        qint64 lastBytes = 0;
+        double connectionRate = 0;      // smoothed bytes/s per connection
+        int failures = 0;               // retries since it last delivered data
+        int slowSamples = 0;
+        bool dropped = false;
+        bool verified = false;          // same size and validator as the probe
+        bool probed = false;            // its HEAD has answered
+        qint64 probedSize = -1;
+        QByteArray probedValidator;
+        QString probeError;
+    };
+
+    QNetworkAccessManager *headManager;
+    QList<QNetworkReply*> headReplies;
+    QStringList mirrorUrls;
+    QList<Mirror*> mirrors;
+    QVector<int> workerMirror;
+    QVector<DownloadThread*> threads;
+    QVector<QThread*> ioThreads;
+    QVector<bool> retired;
+    // Shared with a journal save still syncing it.
+    std::shared_ptr<OutputFile> outputFile;
+    BufferPool *bufferPool;
+    SegmentScheduler scheduler;
+    DownloadJournal journal;
+    IntegrityVerifier *verifier;
+    QHash<qint64, int> pieceRetries;
+    QTimer *journalTimer;
+    // Bytes on disk: resumed ranges plus everything the workers wrote since.
+    QAtomicInteger<qint64> receivedBytes;
+    QTimer *progressTimer;
+    int lastPercentage;
+    QVector<int> threadPercentages;
+
+    QTime startTime;
+    QTimer *speedTimer;
+    qint64 lastBytesReceived;
+
+    // Per-worker state of the last trace sample.
+    struct TraceSample {
+        qint64 transferred = 0;
+        qint64 writeNanos = 0;
+        qint64 segmentStart = 0;
+        qint64 stallSince = -1;
+    };
+
+    QString traceFile;
+    TraceRecorder trace;
+    QVector<TraceSample> traceSamples;
+    qint64 lastTraceSample;
+    qint64 traceWriteNanos;
+    int dnsLookup;
+
+    ContentCache *cache;
+    ContentCache::Entry cached;
+    QByteArray expectedSha256;      // hex, when the expected digest is one
+    // The cached copy could not be used: the next start ignores it.
+    bool cacheBypass;
+    ZsyncManifest delta;
+    QString deltaSeed;
+    StreamExtractor *extractor;
+    QString extractDirectory;
+    QString extractionError;
+    PrefixStreamer *streamer;
+    QString streamTarget;
+    qint64 streamWindow;
+    QString streamError;
+    // Extracting or streaming a copy served from the cache: their end ends
+    // the download.
+    bool processingCached;
+
+    // Cache copies and seed scans run off this thread; results of one started
+    // before the last cancel() are dropped.
+    int taskGeneration;
+    // Bumped by every journal save, write and removal: a save that finds it
+    // moved on leaves the journal to the later one.
+    QAtomicInt journalEpoch;
+    QMutex journalMutex;
+    QThreadPool fileTasks;
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include "downloadqueue.h"
+#include "downloadmanager.h"
+#include <QHash>
+#include <QUrl>
+#include <algorithm>
+
+DownloadQueue::DownloadQueue(QObject *parent)
+    : QObject(parent), nextJobId(0), maxConnections(32), maxConnectionsPerHost(16), rebalanceScheduled(false) {}
+
+void DownloadQueue::setMaxConnections(int count) {
+    maxConnections = qMax(1, count);
+    scheduleRebalance();
+}
+
+void DownloadQueue::setMaxConnectionsPerHost(int count) {
+    maxConnectionsPerHost = qMax(1, count);
+    scheduleRebalance();
+}
+
+int DownloadQueue::addJob(const QString &url, const QString &savePath, int priority) {
+    Job job;
+    job.id = nextJobId++;
+    job.url = url;
+    job.savePath = savePath;
+    job.host = QUrl(url).host();
+    job.priority = priority;
+    job.state = Queued;
+    job.manager = new DownloadManager(this);
+    job.manager->setConnectionAllowance(0);
+
+    int jobId = job.id;
+    connect(job.manager, &DownloadManager::progressUpdated, this, [this, jobId](int percentage) {
+        emit jobProgress(jobId, percentage);
+    });
+    connect(job.manager, &DownloadManager::logMessage, this, [this, jobId](const QString &message) {
+        emit logMessage(jobId, message);
+    });
+    connect(job.manager, &DownloadManager::downloadFinished, this, [this, jobId](bool success, const QString &message) {
+        onJobFinished(jobId, success, message);
+    });
+    connect(job.manager, &DownloadManager::connectionDemandChanged, this, &DownloadQueue::scheduleRebalance);
+
+    jobs.append(job);
+    scheduleRebalance();
+    return jobId;
+}
+
+void DownloadQueue::setPriority(int jobId, int priority) {
+    if (Job *job = findJob(jobId)) {
+        job->priority = priority;
+        scheduleRebalance();
+    }
+}
+
+void DownloadQueue::cancelJob(int jobId, bool deletePartial) {
+    Job *job = findJob(jobId);
+    if (!job || job->state == Finished || job->state == Failed) {
+        return;
+    }
+    job->manager->cancel(deletePartial);
+    onJobFinished(jobId, false, "Téléchargement annulé");
+}
+
+DownloadManager *DownloadQueue::manager(int jobId) const {
+    const Job *job = findJob(jobId);
+    return job ? job->manager : nullptr;
+}
+
+DownloadQueue::JobState DownloadQueue::state(int jobId) const {
+    const Job *job = findJob(jobId);
+    return job ? job->state : Failed;
+}
+
+int DownloadQueue::pendingCount() const {
+    int count = 0;
+    for (const Job &job : jobs) {
+        if (job.state == Queued || job.state == Running) {
+            count++;
+        }
+    }
+    return count;
+}
+
+DownloadQueue::Job *DownloadQueue::findJob(int jobId) {
+    for (Job &job : jobs) {
+        if (job.id == jobId) {
+            return &job;
+        }
+    }
+    return nullptr;
+}
+
+const DownloadQueue::Job *DownloadQueue::findJob(int jobId) const {
+    for (const Job &job : jobs) {
+        if (job.id == jobId) {
+            return &job;
+        }
+    }
+    return nullptr;
+}
+
+void DownloadQueue::onJobFinished(int jobId, bool success, const QString &message) {
+    Job *job = findJob(jobId);
+    if (!job || job->state == Finished || job->state == Failed) {
+        return;
+    }
+    job->state = success ? Finished : Failed;
+    job->manager->setConnectionAllowance(0);
+
+    emit jobFinished(jobId, success, message);
+    scheduleRebalance();
+    if (pendingCount() == 0) {
+        emit allFinished();
+    }
+}
+
+void DownloadQueue::scheduleRebalance() {
+    // Coalesce the bursts of demand changes into one pass.
+    if (rebalanceScheduled) {
+        return;
+    }
+    rebalanceScheduled = true;
+    QMetaObject::invokeMethod(this, [this]() {
+        rebalanceScheduled = false;
+        rebalance();
+    }, Qt::QueuedConnection);
+}
+
+void DownloadQueue::rebalance() {
+    QList<Job*> open;
+    for (Job &job : jobs) {
+        if (job.state == Queued || job.state == Running) {
+            open.append(&job);
+        }
+    }
+    std::stable_sort(open.begin(), open.end(), [](const Job *a, const Job *b) {
+        return a->priority > b->priority;
+    });
+
+    QHash<int, int> grants;
+    QHash<QString, int> hostUsed;
+    int used = 0;
+
+    for (int tierStart = 0; tierStart < open.size();) {
+        int tierEnd = tierStart;
+        while (tierEnd < open.size() && open[tierEnd]->priority == open[tierStart]->priority) {
+            tierEnd++;
+        }
+
+        // Within a tier, hand out one connection per job per round until every
+        // job has what it asks for or the budget is spent.
+        bool granted = true;
+        while (granted && used < maxConnections) {
+            granted = false;
+            for (int i = tierStart; i < tierEnd && used < maxConnections; ++i) {
+                Job *job = open[i];
+                int wanted = qMax(1, job->manager->connectionDemand());
+                if (grants.value(job->id) >= wanted || hostUsed.value(job->host) >= maxConnectionsPerHost) {
+                    continue;
+                }
+                grants[job->id]++;
+                hostUsed[job->host]++;
+                used++;
+                granted = true;
+            }
+        }
+        tierStart = tierEnd;
+    }
+
+    for (Job *job : open) {
+        int grant = grants.value(job->id);
+        job->manager->setConnectionAllowance(grant);
+        if (job->state == Queued && grant > 0) {
+            job->state = Running;
+            emit jobStarted(job->id);
+            job->manager->startDownload(job->url, job->savePath);
+        }
+    }
+}
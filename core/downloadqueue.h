@@ -0,0 +1,66 @@
+#ifndef DOWNLOADQUEUE_H
+#define DOWNLOADQUEUE_H
+
+#include <QList>
+#include <QObject>
+#include <QString>
+
+class DownloadManager;
+
+// Runs many downloads at once under a global connection budget and a
+// per-host cap. Connections go to the highest priority unfinished jobs first;
+// jobs of equal priority share them evenly, so small files are not stuck
+// behind a huge one.
+class DownloadQueue : public QObject {
+    Q_OBJECT
+
+public:
+    enum JobState { Queued, Running, Finished, Failed };
+
+    explicit DownloadQueue(QObject *parent = nullptr);
+
+    void setMaxConnections(int count);
+    void setMaxConnectionsPerHost(int count);
+
+    // Higher priority is served first. The manager can be configured
+    // (connection limits, retries, rate) before the job starts.
+    int addJob(const QString &url, const QString &savePath, int priority = 0);
+    void setPriority(int jobId, int priority);
+    void cancelJob(int jobId, bool deletePartial = false);
+
+    DownloadManager *manager(int jobId) const;
+    JobState state(int jobId) const;
+    int pendingCount() const;
+
+signals:
+    void jobStarted(int jobId);
+    void jobProgress(int jobId, int percentage);
+    void jobFinished(int jobId, bool success, const QString &message);
+    void logMessage(int jobId, const QString &message);
+    void allFinished();
+
+private:
+    struct Job {
+        int id;
+        QString url;
+        QString savePath;
+        QString host;
+        int priority;
+        JobState state;
+        DownloadManager *manager;
+    };
+
+    Job *findJob(int jobId);
+    const Job *findJob(int jobId) const;
+    void onJobFinished(int jobId, bool success, const QString &message);
+    void scheduleRebalance();
+    void rebalance();
+
+    QList<Job> jobs;
+    int nextJobId;
+    int maxConnections;
+    int maxConnectionsPerHost;
+    bool rebalanceScheduled;
+};
+
+#endif
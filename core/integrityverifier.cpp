@@ -0,0 +1,323 @@
+#include "integrityverifier.h"
+#include "crc32c.h"
+#include <QCryptographicHash>
+#include <QFile>
+#include <QtEndian>
+
+// Hashing unit when no piece digests are given.
+static const qint64 DefaultBlockSize = 4 * 1024 * 1024;
+static const qint64 ReadSize = 1024 * 1024;
+
+static bool isCryptographic(IntegrityVerifier::Algorithm algorithm) {
+    return algorithm != IntegrityVerifier::NoAlgorithm && algorithm != IntegrityVerifier::Crc32c;
+}
+
+static QCryptographicHash::Algorithm qtAlgorithm(IntegrityVerifier::Algorithm algorithm) {
+    switch (algorithm) {
+    case IntegrityVerifier::Md5:    return QCryptographicHash::Md5;
+    case IntegrityVerifier::Sha1:   return QCryptographicHash::Sha1;
+    case IntegrityVerifier::Sha512: return QCryptographicHash::Sha512;
+    default:                        return QCryptographicHash::Sha256;
+    }
+}
+
+static QByteArray crcDigest(quint32 crc) {
+    QByteArray digest(4, Qt::Uninitialized);
+    qToBigEndian(crc, digest.data());
+    return digest;
+}
+
+// Feeds bytes start..end of the file to hash and/or crc.
+static bool readRange(const QString &path, qint64 start, qint64 end, QCryptographicHash *hash, quint32 *crc) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly) || !file.seek(start)) {
+        return false;
+    }
+    QByteArray buffer(ReadSize, Qt::Uninitialized);
+    qint64 remaining = end - start + 1;
+    while (remaining > 0) {
+        qint64 read = file.read(buffer.data(), qMin(remaining, ReadSize));
+        if (read <= 0) {
+            return false;
+        }
+        if (hash) {
+            hash->addData(QByteArrayView(buffer.constData(), read));
+        }
+        if (crc) {
+            *crc = crc32c(*crc, buffer.constData(), read);
+        }
+        remaining -= read;
+    }
+    return true;
+}
+
+IntegrityVerifier::Algorithm IntegrityVerifier::algorithmFromName(const QString &name) {
+    QString key = name.toLower().remove('-');
+    if (key == "md5") return Md5;
+    if (key == "sha1") return Sha1;
+    if (key == "sha256") return Sha256;
+    if (key == "sha512") return Sha512;
+    if (key == "crc32c") return Crc32c;
+    return NoAlgorithm;
+}
+
+QString IntegrityVerifier::algorithmName(Algorithm algorithm) {
+    switch (algorithm) {
+    case Md5:    return "md5";
+    case Sha1:   return "sha1";
+    case Sha256: return "sha256";
+    case Sha512: return "sha512";
+    case Crc32c: return "crc32c";
+    default:     return QString();
+    }
+}
+
+bool IntegrityVerifier::parseDigest(const QString &text, Algorithm &algorithm, QByteArray &digest) {
+    int colon = text.indexOf(':');
+    if (colon < 0) {
+        return false;
+    }
+    algorithm = algorithmFromName(text.left(colon).trimmed());
+    digest = QByteArray::fromHex(text.mid(colon + 1).trimmed().toLatin1());
+
+    int expectedLength = algorithm == Crc32c ? 4 : QCryptographicHash::hashLength(qtAlgorithm(algorithm));
+    return algorithm != NoAlgorithm && digest.size() == expectedLength;
+}
+
+IntegrityVerifier::IntegrityVerifier(QObject *parent)
+    : QObject(parent), fileSize(0), blockSize(DefaultBlockSize), fileAlgorithm(NoAlgorithm), pieceAlgorithm(NoAlgorithm),
+      pieceLength(0), generation(0), prefixBlocks(0), prefixRunning(false), running(false), done(false) {
+    pool.setObjectName("FastDoms integrity");
+}
+
+IntegrityVerifier::~IntegrityVerifier() {
+    // Running jobs post their results to this object: let them finish first.
+    pool.clear();
+    pool.waitForDone();
+}
+
+void IntegrityVerifier::setExpectedDigest(Algorithm algorithm, const QByteArray &digest) {
+    fileAlgorithm = algorithm;
+    fileDigest = digest;
+}
+
+void IntegrityVerifier::setPieceDigests(Algorithm algorithm, qint64 pieceLength, const QList<QByteArray> &digests) {
+    pieceAlgorithm = digests.isEmpty() ? NoAlgorithm : algorithm;
+    this->pieceLength = pieceLength;
+    pieceDigests = digests;
+}
+
+void IntegrityVerifier::clearDigests() {
+    setExpectedDigest(NoAlgorithm, QByteArray());
+    setPieceDigests(NoAlgorithm, 0, {});
+}
+
+bool IntegrityVerifier::isEnabled() const {
+    return fileAlgorithm != NoAlgorithm || pieceAlgorithm != NoAlgorithm;
+}
+
+bool IntegrityVerifier::hasPieceDigests() const {
+    return pieceAlgorithm != NoAlgorithm;
+}
+
+bool IntegrityVerifier::start(const QString &path, qint64 size) {
+    reset();
+    filePath = path;
+    fileSize = size;
+    blockSize = pieceAlgorithm != NoAlgorithm ? pieceLength : DefaultBlockSize;
+
+    int count = blockSize > 0 ? int((size + blockSize - 1) / blockSize) : 0;
+    if (pieceAlgorithm != NoAlgorithm && count != pieceDigests.size()) {
+        return false;
+    }
+    blocks.fill(Missing, count);
+    blockCrcs.fill(0, count);
+    if (isCryptographic(fileAlgorithm)) {
+        fileHash = std::make_shared<QCryptographicHash>(qtAlgorithm(fileAlgorithm));
+    }
+    running = true;
+    return true;
+}
+
+void IntegrityVerifier::reset() {
+    pool.clear();
+    generation++;
+    blocks.clear();
+    blockCrcs.clear();
+    prefixBlocks = 0;
+    prefixRunning = false;
+    fileHash.reset();
+    running = false;
+    done = false;
+}
+
+void IntegrityVerifier::update(const RangeSet &completed) {
+    if (!running || done) {
+        return;
+    }
+
+    // Without block digests a complete block only has to feed the prefix hash.
+    bool hashBlocks = pieceAlgorithm != NoAlgorithm || fileAlgorithm == Crc32c;
+    for (int i = 0; i < blocks.size(); ++i) {
+        if (blocks[i] != Missing) {
+            continue;
+        }
+        ByteRange range = blockRange(i);
+        if (!completed.contains(range.start, range.end)) {
+            continue;
+        }
+        if (hashBlocks) {
+            hashBlock(i);
+        } else {
+            blocks[i] = Verified;
+        }
+    }
+
+    advancePrefix();
+    checkFinished();
+}
+
+bool IntegrityVerifier::isFinished() const {
+    return done;
+}
+
+ByteRange IntegrityVerifier::blockRange(int index) const {
+    qint64 start = index * blockSize;
+    return {start, qMin(start + blockSize, fileSize) - 1};
+}
+
+void IntegrityVerifier::hashBlock(int index) {
+    blocks[index] = Hashing;
+
+    ByteRange range = blockRange(index);
+    QString path = filePath;
+    int jobGeneration = generation;
+    Algorithm algorithm = pieceAlgorithm;
+    bool wantCrc = fileAlgorithm == Crc32c || algorithm == Crc32c;
+
+    pool.start([this, path, range, index, jobGeneration, algorithm, wantCrc]() {
+        std::unique_ptr<QCryptographicHash> hash;
+        if (isCryptographic(algorithm)) {
+            hash = std::make_unique<QCryptographicHash>(qtAlgorithm(algorithm));
+        }
+        quint32 crc = 0;
+        bool readOk = readRange(path, range.start, range.end, hash.get(), wantCrc ? &crc : nullptr);
+        QByteArray digest = hash ? hash->result() : crcDigest(crc);
+
+        QMetaObject::invokeMethod(this, [=]() {
+            onBlockHashed(jobGeneration, index, readOk, digest, crc);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void IntegrityVerifier::onBlockHashed(int generation, int index, bool readOk, const QByteArray &digest, quint32 crc) {
+    if (generation != this->generation || done) {
+        return;
+    }
+    if (!readOk) {
+        finish(false, "Lecture du fichier impossible pendant la vérification");
+        return;
+    }
+
+    blockCrcs[index] = crc;
+    if (pieceAlgorithm != NoAlgorithm && digest != pieceDigests[index]) {
+        blocks[index] = Missing;
+        ByteRange range = blockRange(index);
+        emit pieceFailed(range.start, range.end);
+        // The receiver may have given up on the download and reset us.
+        if (generation != this->generation) {
+            return;
+        }
+    } else {
+        blocks[index] = Verified;
+    }
+
+    advancePrefix();
+    checkFinished();
+}
+
+void IntegrityVerifier::advancePrefix() {
+    if (!fileHash || prefixRunning) {
+        return;
+    }
+    int end = prefixBlocks;
+    while (end < blocks.size() && blocks[end] == Verified) {
+        end++;
+    }
+    if (end == prefixBlocks) {
+        return;
+    }
+
+    // The whole-file hash is sequential: one job at a time, over verified blocks only.
+    prefixRunning = true;
+    qint64 start = blockRange(prefixBlocks).start;
+    qint64 last = blockRange(end - 1).end;
+    QString path = filePath;
+    int jobGeneration = generation;
+    std::shared_ptr<QCryptographicHash> hash = fileHash;
+
+    pool.start([this, path, start, last, end, jobGeneration, hash]() {
+        bool readOk = readRange(path, start, last, hash.get(), nullptr);
+        QMetaObject::invokeMethod(this, [=]() {
+            onPrefixHashed(jobGeneration, end, readOk);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void IntegrityVerifier::onPrefixHashed(int generation, int end, bool readOk) {
+    if (generation != this->generation || done) {
+        return;
+    }
+    prefixRunning = false;
+    if (!readOk) {
+        finish(false, "Lecture du fichier impossible pendant la vérification");
+        return;
+    }
+    prefixBlocks = end;
+
+    advancePrefix();
+    checkFinished();
+}
+
+void IntegrityVerifier::checkFinished() {
+    if (!running || done || prefixRunning) {
+        return;
+    }
+    for (BlockState state : blocks) {
+        if (state != Verified) {
+            return;
+        }
+    }
+
+    if (fileAlgorithm == NoAlgorithm) {
+        finish(true, QString("%1 segments vérifiés (%2)").arg(blocks.size()).arg(algorithmName(pieceAlgorithm)));
+        return;
+    }
+
+    QByteArray actual;
+    if (fileAlgorithm == Crc32c) {
+        quint32 crc = 0;
+        for (int i = 0; i < blocks.size(); ++i) {
+            crc = crc32cCombine(crc, blockCrcs[i], blockRange(i).length());
+        }
+        actual = crcDigest(crc);
+    } else {
+        if (prefixBlocks < blocks.size()) {
+            return;
+        }
+        actual = fileHash->result();
+    }
+
+    if (actual == fileDigest) {
+        finish(true, QString("%1 vérifié: %2").arg(algorithmName(fileAlgorithm), QString(actual.toHex())));
+    } else {
+        finish(false, QString("Empreinte %1 incorrecte: %2 au lieu de %3")
+                          .arg(algorithmName(fileAlgorithm), QString(actual.toHex()), QString(fileDigest.toHex())));
+    }
+}
+
+void IntegrityVerifier::finish(bool success, const QString &message) {
+    done = true;
+    pool.clear();
+    emit finished(success, message);
+}
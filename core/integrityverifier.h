@@ -0,0 +1,90 @@
+#ifndef INTEGRITYVERIFIER_H
+#define INTEGRITYVERIFIER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QObject>
+#include <QThreadPool>
+#include <QVector>
+#include <memory>
+#include "rangeset.h"
+
+class QCryptographicHash;
+
+// Checks a download against expected digests while it is still running.
+// The file is cut into blocks (the pieces when piece digests are known); each
+// block is hashed on a pool thread as soon as it is on disk, right after it was
+// written and while it is still in the page cache. A whole-file CRC32C is
+// combined from the block CRCs; a whole-file SHA digest follows the verified
+// contiguous prefix. A piece that does not match is reported so that only its
+// bytes are downloaded again; a whole-file digest alone cannot tell which
+// bytes are wrong.
+class IntegrityVerifier : public QObject {
+    Q_OBJECT
+
+public:
+    enum Algorithm { NoAlgorithm, Md5, Sha1, Sha256, Sha512, Crc32c };
+
+    // Accepts names such as "sha256", "SHA-256" or "crc32c".
+    static Algorithm algorithmFromName(const QString &name);
+    static QString algorithmName(Algorithm algorithm);
+    // Parses "algorithm:hex", e.g. "sha256:9f86d0…".
+    static bool parseDigest(const QString &text, Algorithm &algorithm, QByteArray &digest);
+
+    explicit IntegrityVerifier(QObject *parent = nullptr);
+    ~IntegrityVerifier();
+
+    void setExpectedDigest(Algorithm algorithm, const QByteArray &digest);
+    // Digests of consecutive pieces of pieceLength bytes, the last one shorter.
+    void setPieceDigests(Algorithm algorithm, qint64 pieceLength, const QList<QByteArray> &digests);
+    void clearDigests();
+    bool isEnabled() const;
+    // A mismatch can be traced to a piece.
+    bool hasPieceDigests() const;
+
+    // Fails if the piece digests do not cover a file of this size.
+    bool start(const QString &path, qint64 size);
+    // Forgets the current file; results of hashing still in flight are ignored.
+    void reset();
+    // Schedules every block that completed now covers entirely.
+    void update(const RangeSet &completed);
+    bool isFinished() const;
+
+signals:
+    // The piece on disk does not match its digest; start..end must be fetched again.
+    void pieceFailed(qint64 start, qint64 end);
+    void finished(bool success, const QString &message);
+
+private:
+    enum BlockState { Missing, Hashing, Verified };
+
+    ByteRange blockRange(int index) const;
+    void hashBlock(int index);
+    void onBlockHashed(int generation, int index, bool readOk, const QByteArray &digest, quint32 crc);
+    void advancePrefix();
+    void onPrefixHashed(int generation, int end, bool readOk);
+    void checkFinished();
+    void finish(bool success, const QString &message);
+
+    QThreadPool pool;
+    QString filePath;
+    qint64 fileSize;
+    qint64 blockSize;
+
+    Algorithm fileAlgorithm;
+    QByteArray fileDigest;
+    Algorithm pieceAlgorithm;
+    qint64 pieceLength;
+    QList<QByteArray> pieceDigests;
+
+    QVector<BlockState> blocks;
+    QVector<quint32> blockCrcs;
+    int generation;
+    int prefixBlocks;
+    bool prefixRunning;
+    std::shared_ptr<QCryptographicHash> fileHash;
+    bool running;
+    bool done;
+};
+
+#endif
@@ -0,0 +1,96 @@
+#include "iothreadpool.h"
+#include <QCoreApplication>
+#include <QMutexLocker>
+#include <QThread>
+
+static const int ConnectionsPerManager = 6;
+static const int MaxThreads = 64;
+
+IoThreadPool *IoThreadPool::instance() {
+    // Parented to the application so the threads are joined on exit.
+    static IoThreadPool *pool = new IoThreadPool(QCoreApplication::instance());
+    return pool;
+}
+
+IoThreadPool::IoThreadPool(QObject *parent) : QObject(parent) {
+    int count = qMax(2, QThread::idealThreadCount());
+    for (int i = 0; i < count; ++i) {
+        addThread();
+    }
+}
+
+IoThreadPool::~IoThreadPool() {
+    for (const IoThread &ioThread : ioThreads) {
+        ioThread.thread->quit();
+    }
+    for (const IoThread &ioThread : ioThreads) {
+        ioThread.thread->wait();
+        delete ioThread.thread;
+    }
+}
+
+int IoThreadPool::addThread() {
+    IoThread ioThread;
+    ioThread.thread = new QThread();
+    ioThread.thread->setObjectName(QString("FastDoms I/O %1").arg(ioThreads.size()));
+    for (int i = 0; i < Transport::BackendCount; ++i) {
+        Transport *transport = Transport::create(Transport::Backend(i));
+        if (transport) {
+            transport->moveToThread(ioThread.thread);
+            connect(ioThread.thread, &QThread::finished, transport, &QObject::deleteLater);
+        }
+        ioThread.transports[i] = transport;
+    }
+    ioThread.load = 0;
+    ioThread.thread->start();
+
+    ioThreads.append(ioThread);
+    return ioThreads.size() - 1;
+}
+
+QThread *IoThreadPool::acquire() {
+    QMutexLocker locker(&mutex);
+
+    int best = 0;
+    for (int i = 1; i < ioThreads.size(); ++i) {
+        if (ioThreads[i].load < ioThreads[best].load) {
+            best = i;
+        }
+    }
+    if (ioThreads[best].load >= ConnectionsPerManager && ioThreads.size() < MaxThreads) {
+        best = addThread();
+    }
+
+    ioThreads[best].load++;
+    return ioThreads[best].thread;
+}
+
+void IoThreadPool::acquire(QThread *thread) {
+    QMutexLocker locker(&mutex);
+    for (IoThread &ioThread : ioThreads) {
+        if (ioThread.thread == thread) {
+            ioThread.load++;
+            return;
+        }
+    }
+}
+
+void IoThreadPool::release(QThread *thread) {
+    QMutexLocker locker(&mutex);
+    for (IoThread &ioThread : ioThreads) {
+        if (ioThread.thread == thread) {
+            ioThread.load--;
+            return;
+        }
+    }
+}
+
+Transport *IoThreadPool::transport(QThread *thread, Transport::Backend backend) const {
+    QMutexLocker locker(&mutex);
+    for (const IoThread &ioThread : ioThreads) {
+        if (ioThread.thread == thread) {
+            return ioThread.transports[backend];
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,47 @@
+#ifndef IOTHREADPOOL_H
+#define IOTHREADPOOL_H
+
+#include <QMutex>
+#include <QObject>
+#include <QVector>
+#include "transport.h"
+
+class QThread;
+
+// Process-wide set of event-loop threads, about one per core, each with a
+// long-lived transport per available backend. Segments of every download are
+// spread over them, so DNS results and keep-alive connections are reused
+// across segments and across downloads.
+class IoThreadPool : public QObject {
+    Q_OBJECT
+
+public:
+    static IoThreadPool *instance();
+    ~IoThreadPool();
+
+    // Least loaded thread. Qt's transport opens at most six HTTP/1.1
+    // connections per host, so a thread is added when all of them have that many.
+    QThread *acquire();
+    // Counts one more user of a thread already handed out, for requests that
+    // have to share its transport (HTTP/2 streams of one connection).
+    void acquire(QThread *thread);
+    void release(QThread *thread);
+
+    // Only to be used from the given thread; null if backend is not available.
+    Transport *transport(QThread *thread, Transport::Backend backend) const;
+
+private:
+    explicit IoThreadPool(QObject *parent = nullptr);
+    int addThread();
+
+    struct IoThread {
+        QThread *thread;
+        Transport *transports[Transport::BackendCount];
+        int load;
+    };
+
+    mutable QMutex mutex;
+    QVector<IoThread> ioThreads;
+};
+
+#endif
@@ -0,0 +1,121 @@
+#include "metalink.h"
+#include <QFile>
+#include <QUrl>
+#include <QXmlStreamReader>
+#include <algorithm>
+
+// Strongest first, so the best digest a document offers is the one checked.
+static int strength(IntegrityVerifier::Algorithm algorithm) {
+    switch (algorithm) {
+    case IntegrityVerifier::Sha512: return 5;
+    case IntegrityVerifier::Sha256: return 4;
+    case IntegrityVerifier::Sha1:   return 3;
+    case IntegrityVerifier::Md5:    return 2;
+    case IntegrityVerifier::Crc32c: return 1;
+    default:                        return 0;
+    }
+}
+
+bool Metalink::parse(const QByteArray &document, Metalink &metalink, QString *error) {
+    struct Source {
+        QString url;
+        int rank;
+    };
+    QList<Source> sources;
+
+    metalink = Metalink();
+    QXmlStreamReader xml(document);
+    bool inFile = false;
+    bool inPieces = false;
+    IntegrityVerifier::Algorithm piecesAlgorithm = IntegrityVerifier::NoAlgorithm;
+    qint64 piecesLength = 0;
+    QList<QByteArray> piecesHashes;
+
+    while (!xml.atEnd()) {
+        xml.readNext();
+        if (xml.isEndElement()) {
+            if (xml.name() == QLatin1String("file") && inFile) {
+                break;
+            }
+            if (xml.name() == QLatin1String("pieces")) {
+                inPieces = false;
+                if (strength(piecesAlgorithm) > strength(metalink.pieceAlgorithm)) {
+                    metalink.pieceAlgorithm = piecesAlgorithm;
+                    metalink.pieceLength = piecesLength;
+                    metalink.pieces = piecesHashes;
+                }
+            }
+            continue;
+        }
+        if (!xml.isStartElement()) {
+            continue;
+        }
+
+        QStringView name = xml.name();
+        QXmlStreamAttributes attributes = xml.attributes();
+        if (name == QLatin1String("file")) {
+            inFile = true;
+            metalink.name = attributes.value("name").toString();
+        } else if (!inFile) {
+            continue;
+        } else if (name == QLatin1String("size")) {
+            metalink.size = xml.readElementText().trimmed().toLongLong();
+        } else if (name == QLatin1String("url")) {
+            // 4.0 ranks by "priority" (1 is best), 3.0 by "preference" (100 is best).
+            int rank = attributes.hasAttribute("priority") ? attributes.value("priority").toInt()
+                     : attributes.hasAttribute("preference") ? 101 - attributes.value("preference").toInt()
+                     : 999999;
+            QString url = xml.readElementText().trimmed();
+            QString scheme = QUrl(url).scheme().toLower();
+            if (scheme == "http" || scheme == "https" || scheme == "ftp") {
+                sources.append({url, rank});
+            }
+        } else if (name == QLatin1String("pieces")) {
+            inPieces = true;
+            piecesAlgorithm = IntegrityVerifier::algorithmFromName(attributes.value("type").toString());
+            piecesLength = attributes.value("length").toLongLong();
+            piecesHashes.clear();
+        } else if (name == QLatin1String("hash")) {
+            IntegrityVerifier::Algorithm algorithm = IntegrityVerifier::algorithmFromName(attributes.value("type").toString());
+            QByteArray digest = QByteArray::fromHex(xml.readElementText().trimmed().toLatin1());
+            if (inPieces) {
+                piecesHashes.append(digest);
+            } else if (strength(algorithm) > strength(metalink.hashAlgorithm)) {
+                metalink.hashAlgorithm = algorithm;
+                metalink.hash = digest;
+            }
+        }
+    }
+
+    if (xml.hasError()) {
+        if (error) {
+            *error = xml.errorString();
+        }
+        return false;
+    }
+    if (sources.isEmpty()) {
+        if (error) {
+            *error = "aucune URL http(s) ou ftp";
+        }
+        return false;
+    }
+
+    std::stable_sort(sources.begin(), sources.end(), [](const Source &a, const Source &b) {
+        return a.rank < b.rank;
+    });
+    for (const Source &source : sources) {
+        metalink.urls.append(source.url);
+    }
+    return true;
+}
+
+bool Metalink::load(const QString &path, Metalink &metalink, QString *error) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return false;
+    }
+    return parse(file.readAll(), metalink, error);
+}
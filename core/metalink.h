@@ -0,0 +1,29 @@
+#ifndef METALINK_H
+#define METALINK_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include "integrityverifier.h"
+
+// One file described by a Metalink document (RFC 5854 ".meta4", or the older
+// 3.0 ".metalink" format): its mirrors, best first, and its digests.
+struct Metalink {
+    QString name;
+    qint64 size = 0;
+    QStringList urls;
+
+    IntegrityVerifier::Algorithm hashAlgorithm = IntegrityVerifier::NoAlgorithm;
+    QByteArray hash;
+
+    IntegrityVerifier::Algorithm pieceAlgorithm = IntegrityVerifier::NoAlgorithm;
+    qint64 pieceLength = 0;
+    QList<QByteArray> pieces;
+
+    // Reads the first file of the document. Only http(s) and ftp URLs are kept.
+    static bool parse(const QByteArray &document, Metalink &metalink, QString *error = nullptr);
+    static bool load(const QString &path, Metalink &metalink, QString *error = nullptr);
+};
+
+#endif
@@ -0,0 +1,156 @@
+#include "outputfile.h"
+#include <QFileInfo>
+#include <QMutexLocker>
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+OutputFile::OutputFile() : fileSize(0) {}
+
+OutputFile::~OutputFile() {
+    close();
+}
+
+bool OutputFile::open(const QString &path, qint64 size, bool keepContents) {
+    close();
+
+    QIODevice::OpenMode mode = QIODevice::ReadWrite | QIODevice::Unbuffered;
+    if (!keepContents) {
+        mode |= QIODevice::Truncate;
+    }
+
+    file.setFileName(path);
+    if (!file.open(mode)) {
+        setError(file.errorString());
+        return false;
+    }
+
+    if (!preallocate(size)) {
+        file.close();
+        return false;
+    }
+
+    fileSize = size;
+    return true;
+}
+
+bool OutputFile::preallocate(qint64 size) {
+#ifdef Q_OS_LINUX
+    // Reserve the blocks up front so parallel writes don't fragment the file.
+    if (posix_fallocate(file.handle(), 0, size) == 0) {
+        return true;
+    }
+#endif
+    // Sparse fallback: the filesystem allocates blocks as segments write them.
+    if (!file.resize(size)) {
+        setError(file.errorString());
+        return false;
+    }
+    return true;
+}
+
+bool OutputFile::writeAt(qint64 offset, const char *data, qint64 length) {
+#ifdef Q_OS_UNIX
+    int fd = file.handle();
+    while (length > 0) {
+        ssize_t written = ::pwrite(fd, data, static_cast<size_t>(length), static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            setError(QString::fromLocal8Bit(std::strerror(errno)));
+            return false;
+        }
+        data += written;
+        offset += written;
+        length -= written;
+    }
+    return true;
+#else
+    QMutexLocker locker(&mutex);
+    if (!file.seek(offset) || file.write(data, length) != length) {
+        lastError = file.errorString();
+        return false;
+    }
+    return true;
+#endif
+}
+
+bool OutputFile::sync() {
+    // Journal saves sync from another thread: never on a closed handle.
+    QMutexLocker locker(&mutex);
+    if (!file.isOpen()) {
+        lastError = "fichier fermé";
+        return false;
+    }
+#ifdef Q_OS_UNIX
+#ifdef Q_OS_LINUX
+    int result = ::fdatasync(file.handle());
+#else
+    int result = ::fsync(file.handle());
+#endif
+    if (result != 0) {
+        lastError = QString::fromLocal8Bit(std::strerror(errno));
+        return false;
+    }
+    return true;
+#else
+    return file.flush();
+#endif
+}
+
+bool OutputFile::commit(const QString &finalPath) {
+    if (!sync()) {
+        return false;
+    }
+
+    QString partPath = file.fileName();
+    close();
+
+#ifdef Q_OS_UNIX
+    if (::rename(QFile::encodeName(partPath).constData(), QFile::encodeName(finalPath).constData()) != 0) {
+        setError(QString::fromLocal8Bit(std::strerror(errno)));
+        return false;
+    }
+
+    // Persist the rename itself.
+    QByteArray directory = QFile::encodeName(QFileInfo(finalPath).absolutePath());
+    int directoryFd = ::open(directory.constData(), O_RDONLY | O_DIRECTORY);
+    if (directoryFd >= 0) {
+        ::fsync(directoryFd);
+        ::close(directoryFd);
+    }
+    return true;
+#else
+    QFile::remove(finalPath);
+    if (!QFile::rename(partPath, finalPath)) {
+        setError(QString("Impossible de renommer %1 en %2").arg(partPath, finalPath));
+        return false;
+    }
+    return true;
+#endif
+}
+
+void OutputFile::close() {
+    QMutexLocker locker(&mutex);
+    if (file.isOpen()) {
+        file.close();
+    }
+}
+
+qint64 OutputFile::size() const {
+    return fileSize;
+}
+
+QString OutputFile::errorString() const {
+    QMutexLocker locker(&mutex);
+    return lastError;
+}
+
+void OutputFile::setError(const QString &error) {
+    QMutexLocker locker(&mutex);
+    lastError = error;
+}
@@ -0,0 +1,37 @@
+#ifndef OUTPUTFILE_H
+#define OUTPUTFILE_H
+
+#include <QFile>
+#include <QMutex>
+#include <QString>
+
+// Target file shared by every segment: preallocated once, then written at
+// arbitrary offsets from several threads at the same time.
+class OutputFile {
+public:
+    OutputFile();
+    ~OutputFile();
+
+    // With keepContents, an existing file is reopened as is so a previous
+    // run's bytes can be reused.
+    bool open(const QString &path, qint64 size, bool keepContents = false);
+    bool writeAt(qint64 offset, const char *data, qint64 length);
+    bool sync();
+    // Flushes to stable storage, then atomically renames onto finalPath.
+    bool commit(const QString &finalPath);
+    void close();
+
+    qint64 size() const;
+    QString errorString() const;
+
+private:
+    bool preallocate(qint64 size);
+    void setError(const QString &error);
+
+    QFile file;
+    qint64 fileSize;
+    mutable QMutex mutex;
+    QString lastError;
+};
+
+#endif
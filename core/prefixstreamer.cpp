@@ -0,0 +1,266 @@
+#include "prefixstreamer.h"
+#include <QAtomicInt>
+#include <QFile>
+#include <QThread>
+#include <cstdio>
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Bytes of the file handed to one job: written() moves at least this often.
+static const qint64 JobBytes = 4 * 1024 * 1024;
+static const qint64 ReadSize = 1024 * 1024;
+// How often a job waiting for the consumer checks whether it was reset.
+static const int WaitPollMs = 100;
+
+// The input file and the output, shared by the jobs of one start().
+class StreamPipe {
+public:
+    StreamPipe(const QString &path, const QString &target) : input(path), target(target), cancelled(false) {}
+
+    bool feed(qint64 start, qint64 end, bool last, QString *error);
+    void cancel() { cancelled.storeRelaxed(1); }
+    QString targetName() const { return target == "-" ? QString("la sortie standard") : target; }
+
+private:
+    bool openOutput(QString *error);
+    bool writeAll(const char *data, qint64 size, QString *error);
+
+    QFile input;
+    QFile output;
+    QString target;
+    QAtomicInt cancelled;
+};
+
+bool StreamPipe::openOutput(QString *error) {
+    if (target == "-") {
+        if (!output.open(fileno(stdout), QIODevice::WriteOnly | QIODevice::Unbuffered, QFileDevice::DontCloseHandle)) {
+            *error = output.errorString();
+            return false;
+        }
+        return true;
+    }
+#ifdef Q_OS_UNIX
+    // Opening a FIFO blocks until a reader comes; polled instead, so a reset
+    // is noticed. The descriptor stays non-blocking for the same reason.
+    struct stat info;
+    QByteArray path = QFile::encodeName(target);
+    if (::stat(path.constData(), &info) == 0 && S_ISFIFO(info.st_mode)) {
+        int fd;
+        while ((fd = ::open(path.constData(), O_WRONLY | O_NONBLOCK | O_CLOEXEC)) < 0) {
+            if (errno != ENXIO && errno != EINTR) {
+                *error = QString::fromLocal8Bit(std::strerror(errno));
+                return false;
+            }
+            if (cancelled.loadRelaxed()) {
+                *error = "annulé";
+                return false;
+            }
+            QThread::msleep(WaitPollMs);
+        }
+        if (!output.open(fd, QIODevice::WriteOnly | QIODevice::Unbuffered, QFileDevice::AutoCloseHandle)) {
+            ::close(fd);
+            *error = output.errorString();
+            return false;
+        }
+        return true;
+    }
+#endif
+    output.setFileName(target);
+    if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered)) {
+        *error = output.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool StreamPipe::writeAll(const char *data, qint64 size, QString *error) {
+#ifdef Q_OS_UNIX
+    int fd = output.handle();
+    while (size > 0) {
+        if (cancelled.loadRelaxed()) {
+            *error = "annulé";
+            return false;
+        }
+        ssize_t written = ::write(fd, data, static_cast<size_t>(size));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                pollfd wait = {fd, POLLOUT, 0};
+                ::poll(&wait, 1, WaitPollMs);
+                continue;
+            }
+            *error = errno == EPIPE ? QString("le lecteur a fermé le flux")
+                                    : QString::fromLocal8Bit(std::strerror(errno));
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+#else
+    if (output.write(data, size) != size) {
+        *error = output.errorString();
+        return false;
+    }
+    return true;
+#endif
+}
+
+bool StreamPipe::feed(qint64 start, qint64 end, bool last, QString *error) {
+    if (!output.isOpen() && !openOutput(error)) {
+        return false;
+    }
+    if (!input.isOpen() && !input.open(QIODevice::ReadOnly)) {
+        *error = input.errorString();
+        return false;
+    }
+    if (!input.seek(start)) {
+        *error = input.errorString();
+        return false;
+    }
+
+    QByteArray buffer(ReadSize, Qt::Uninitialized);
+    qint64 position = start;
+    while (position < end) {
+        qint64 read = input.read(buffer.data(), qMin(ReadSize, end - position));
+        if (read <= 0) {
+            *error = "lecture du fichier impossible pendant l'envoi";
+            return false;
+        }
+        if (!writeAll(buffer.constData(), read, error)) {
+            return false;
+        }
+        position += read;
+    }
+
+    if (last) {
+        output.close();
+    }
+    return true;
+}
+
+PrefixStreamer::PrefixStreamer(QObject *parent)
+    : QObject(parent), generation(0), available(0), writtenBytes(0), requested(0), totalSize(-1),
+      inputComplete(false), jobRunning(false), running(false), done(false) {
+    pool.setObjectName("FastDoms stream");
+    // Bytes go out in order; one thread keeps the jobs in order.
+    pool.setMaxThreadCount(1);
+}
+
+PrefixStreamer::~PrefixStreamer() {
+    // Running jobs post their results to this object: let them finish first.
+    reset();
+    pool.waitForDone();
+}
+
+void PrefixStreamer::start(const QString &path, const QString &target) {
+    reset();
+    pipe = std::make_shared<StreamPipe>(path, target);
+    running = true;
+}
+
+void PrefixStreamer::reset() {
+    pool.clear();
+    generation++;
+    if (pipe) {
+        pipe->cancel();
+    }
+    pipe.reset();
+    available = 0;
+    writtenBytes = 0;
+    requested = 0;
+    totalSize = -1;
+    inputComplete = false;
+    jobRunning = false;
+    running = false;
+    done = false;
+}
+
+bool PrefixStreamer::isRunning() const {
+    return running;
+}
+
+void PrefixStreamer::update(qint64 available) {
+    if (!running || done) {
+        return;
+    }
+    this->available = qMax(this->available, available);
+    schedule();
+}
+
+void PrefixStreamer::finishInput(qint64 size) {
+    if (!running || done) {
+        return;
+    }
+    inputComplete = true;
+    totalSize = size;
+    available = size;
+    schedule();
+}
+
+bool PrefixStreamer::isInputComplete() const {
+    return inputComplete;
+}
+
+qint64 PrefixStreamer::written() const {
+    return writtenBytes;
+}
+
+qint64 PrefixStreamer::consumed() const {
+    return jobRunning ? requested : writtenBytes;
+}
+
+bool PrefixStreamer::isFinished() const {
+    return done;
+}
+
+void PrefixStreamer::schedule() {
+    if (jobRunning || (!inputComplete && available <= writtenBytes)) {
+        return;
+    }
+
+    qint64 start = writtenBytes;
+    qint64 end = qMin(available, writtenBytes + JobBytes);
+    bool last = inputComplete && end >= totalSize;
+    int jobGeneration = generation;
+    std::shared_ptr<StreamPipe> job = pipe;
+    jobRunning = true;
+    requested = end;
+
+    pool.start([this, job, start, end, last, jobGeneration]() {
+        QString message;
+        bool success = job->feed(start, end, last, &message);
+        if (success && last) {
+            message = QString("%1 octets envoyés vers %2").arg(end).arg(job->targetName());
+        }
+        QMetaObject::invokeMethod(this, [=]() {
+            onJobDone(jobGeneration, end, last, success, message);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void PrefixStreamer::onJobDone(int generation, qint64 end, bool last, bool success, const QString &message) {
+    if (generation != this->generation || done) {
+        return;
+    }
+    jobRunning = false;
+    if (success) {
+        writtenBytes = end;
+    }
+    if (!success || last) {
+        done = true;
+        pipe.reset();
+        emit finished(success, message);
+        return;
+    }
+    schedule();
+}
@@ -0,0 +1,61 @@
+#ifndef PREFIXSTREAMER_H
+#define PREFIXSTREAMER_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <memory>
+
+class StreamPipe;
+
+// Copies a download, in order, to stdout, a FIFO or another file while it is
+// still running. Each time the contiguous prefix on disk grows, the new bytes
+// are read back and written out on a pool thread, one job at a time; the
+// partial file is the reorder buffer. A consumer that reads slowly holds back
+// written(), which the scheduler's window follows.
+class PrefixStreamer : public QObject {
+    Q_OBJECT
+
+public:
+    explicit PrefixStreamer(QObject *parent = nullptr);
+    ~PrefixStreamer();
+
+    // Reads path, the file being downloaded, into target: "-" for stdout.
+    // A FIFO is opened once its reader is there.
+    void start(const QString &path, const QString &target);
+    // Forgets the current file; a job still writing gives up.
+    void reset();
+    bool isRunning() const;
+
+    // Bytes [0, available) of the file are on disk.
+    void update(qint64 available);
+    // The file is complete at size bytes.
+    void finishInput(qint64 size);
+    bool isInputComplete() const;
+    // Bytes the consumer has been given.
+    qint64 written() const;
+    // Bytes read to be written, including those of the job in flight: past
+    // this, a change to the file can no longer be taken back.
+    qint64 consumed() const;
+    bool isFinished() const;
+
+signals:
+    void finished(bool success, const QString &message);
+
+private:
+    void schedule();
+    void onJobDone(int generation, qint64 end, bool last, bool success, const QString &message);
+
+    QThreadPool pool;
+    std::shared_ptr<StreamPipe> pipe;
+    int generation;
+    qint64 available;
+    qint64 writtenBytes;
+    qint64 requested;               // end of the job in flight
+    qint64 totalSize;
+    bool inputComplete;
+    bool jobRunning;
+    bool running;
+    bool done;
+};
+
+#endif
@@ -0,0 +1,130 @@
+#include "qttransport.h"
+#include "tlssessioncache.h"
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QSslConfiguration>
+
+#if QT_CONFIG(ssl)
+// Session tickets on, with the one of an earlier handshake with the same
+// host if there is one.
+static QSslConfiguration tlsConfiguration(const QUrl &url, bool http2) {
+    QSslConfiguration configuration = QSslConfiguration::defaultConfiguration();
+    configuration.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+    configuration.setSessionTicket(TlsSessionCache::instance()->ticket(url));
+    if (!http2) {
+        configuration.setAllowedNextProtocols({QSslConfiguration::NextProtocolHttp1_1});
+    }
+    return configuration;
+}
+#endif
+
+QtTransport::QtTransport(QObject *parent) : Transport(parent) {
+    manager = new QNetworkAccessManager(this);
+}
+
+TransportReply *QtTransport::get(const TransportRequest &transportRequest) {
+    QNetworkRequest request(transportRequest.url);
+    for (const auto &header : transportRequest.headers) {
+        request.setRawHeader(header.first, header.second);
+    }
+    request.setTransferTimeout(transportRequest.stallTimeoutMs);
+    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, transportRequest.http2);
+    if (transportRequest.http2) {
+        request.setHttp2Configuration(transportRequest.http2Configuration);
+    }
+#if QT_CONFIG(ssl)
+    if (request.url().scheme() == "https") {
+        request.setSslConfiguration(tlsConfiguration(request.url(), transportRequest.http2));
+    }
+#endif
+
+    QNetworkReply *reply = manager->get(request);
+    reply->setReadBufferSize(transportRequest.readBufferSize);
+    return new QtTransportReply(reply, this);
+}
+
+void QtTransport::preconnect(const QUrl &url, bool http2) {
+#if QT_CONFIG(ssl)
+    if (url.scheme() == "https") {
+        manager->connectToHostEncrypted(url.host(), quint16(url.port(443)), tlsConfiguration(url, http2));
+        return;
+    }
+#else
+    Q_UNUSED(http2);
+#endif
+    manager->connectToHost(url.host(), quint16(url.port(80)));
+}
+
+QtTransportReply::QtTransportReply(QNetworkReply *reply, QObject *parent)
+    : TransportReply(parent), reply(reply) {
+    reply->setParent(this);
+    connect(reply, &QNetworkReply::socketStartedConnecting, this, &TransportReply::socketStartedConnecting);
+    connect(reply, &QNetworkReply::requestSent, this, &TransportReply::requestSent);
+    connect(reply, &QNetworkReply::metaDataChanged, this, &TransportReply::metaDataChanged);
+    connect(reply, &QNetworkReply::readyRead, this, &TransportReply::readyRead);
+    connect(reply, &QNetworkReply::finished, this, &TransportReply::finished);
+#if QT_CONFIG(ssl)
+    if (reply->url().scheme() == "https") {
+        // TLS 1.3 tickets arrive after the handshake: looked for again at the end.
+        connect(reply, &QNetworkReply::encrypted, this, &QtTransportReply::rememberTlsSession);
+        connect(reply, &QNetworkReply::finished, this, &QtTransportReply::rememberTlsSession);
+    }
+#endif
+}
+
+QUrl QtTransportReply::url() const {
+    return reply->url();
+}
+
+int QtTransportReply::statusCode() const {
+    return reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+}
+
+QByteArray QtTransportReply::rawHeader(const QByteArray &name) const {
+    return reply->rawHeader(name);
+}
+
+qint64 QtTransportReply::contentLength() const {
+    QVariant length = reply->header(QNetworkRequest::ContentLengthHeader);
+    return length.isValid() ? length.toLongLong() : -1;
+}
+
+bool QtTransportReply::http2WasUsed() const {
+    return reply->attribute(QNetworkRequest::Http2WasUsedAttribute).toBool();
+}
+
+qint64 QtTransportReply::bytesAvailable() const {
+    return reply->bytesAvailable();
+}
+
+qint64 QtTransportReply::read(char *data, qint64 maxSize) {
+    return reply->read(data, maxSize);
+}
+
+void QtTransportReply::skip() {
+    reply->readAll();
+}
+
+void QtTransportReply::abort() {
+    reply->abort();
+}
+
+bool QtTransportReply::isFinished() const {
+    return reply->isFinished();
+}
+
+QNetworkReply::NetworkError QtTransportReply::error() const {
+    return reply->error();
+}
+
+QString QtTransportReply::errorString() const {
+    return reply->errorString();
+}
+
+void QtTransportReply::rememberTlsSession() {
+#if QT_CONFIG(ssl)
+    QSslConfiguration configuration = reply->sslConfiguration();
+    TlsSessionCache::instance()->store(reply->url(), configuration.sessionTicket(),
+                                       configuration.sessionTicketLifeTimeHint());
+#endif
+}
@@ -0,0 +1,49 @@
+#ifndef QTTRANSPORT_H
+#define QTTRANSPORT_H
+
+#include "transport.h"
+
+class QNetworkAccessManager;
+
+// Qt's own HTTP stack: at most six HTTP/1.1 connections per host and manager,
+// DNS and keep-alive connections shared by the manager's requests.
+class QtTransport : public Transport {
+    Q_OBJECT
+
+public:
+    explicit QtTransport(QObject *parent = nullptr);
+
+    TransportReply *get(const TransportRequest &request) override;
+    void preconnect(const QUrl &url, bool http2) override;
+
+private:
+    QNetworkAccessManager *manager;
+};
+
+class QtTransportReply : public TransportReply {
+    Q_OBJECT
+
+public:
+    QtTransportReply(QNetworkReply *reply, QObject *parent);
+
+    QUrl url() const override;
+    int statusCode() const override;
+    QByteArray rawHeader(const QByteArray &name) const override;
+    qint64 contentLength() const override;
+    bool http2WasUsed() const override;
+    qint64 bytesAvailable() const override;
+    qint64 read(char *data, qint64 maxSize) override;
+    void skip() override;
+    void abort() override;
+    bool isFinished() const override;
+    QNetworkReply::NetworkError error() const override;
+    QString errorString() const override;
+
+private slots:
+    void rememberTlsSession();
+
+private:
+    QNetworkReply *reply;
+};
+
+#endif
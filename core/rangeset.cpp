@@ -0,0 +1,106 @@
+#include "rangeset.h"
+#include <iterator>
+
+void RangeSet::add(qint64 start, qint64 end) {
+    if (end < start) {
+        return;
+    }
+
+    // Absorb the range starting at or before start if it touches the new one.
+    auto it = spans.upperBound(start);
+    if (it != spans.begin()) {
+        auto previous = std::prev(it);
+        if (previous.value() + 1 >= start) {
+            start = previous.key();
+            end = qMax(end, previous.value());
+            spans.erase(previous);
+        }
+    }
+
+    // Absorb every following range that overlaps or touches.
+    it = spans.lowerBound(start);
+    while (it != spans.end() && it.key() <= end + 1) {
+        end = qMax(end, it.value());
+        it = spans.erase(it);
+    }
+
+    spans.insert(start, end);
+}
+
+void RangeSet::remove(qint64 start, qint64 end) {
+    if (end < start) {
+        return;
+    }
+
+    // Start from the range that may straddle start, then trim or drop every overlap.
+    auto it = spans.upperBound(start);
+    if (it != spans.begin()) {
+        --it;
+    }
+    QList<ByteRange> remainders;
+    while (it != spans.end() && it.key() <= end) {
+        if (it.value() < start) {
+            ++it;
+            continue;
+        }
+        if (it.key() < start) {
+            remainders.append({it.key(), start - 1});
+        }
+        if (it.value() > end) {
+            remainders.append({end + 1, it.value()});
+        }
+        it = spans.erase(it);
+    }
+
+    for (const ByteRange &range : remainders) {
+        spans.insert(range.start, range.end);
+    }
+}
+
+void RangeSet::clear() {
+    spans.clear();
+}
+
+bool RangeSet::isEmpty() const {
+    return spans.isEmpty();
+}
+
+bool RangeSet::contains(qint64 start, qint64 end) const {
+    auto it = spans.upperBound(start);
+    if (it == spans.begin()) {
+        return false;
+    }
+    --it;
+    return it.value() >= end;
+}
+
+qint64 RangeSet::totalLength() const {
+    qint64 total = 0;
+    for (auto it = spans.constBegin(); it != spans.constEnd(); ++it) {
+        total += it.value() - it.key() + 1;
+    }
+    return total;
+}
+
+QList<ByteRange> RangeSet::ranges() const {
+    QList<ByteRange> result;
+    for (auto it = spans.constBegin(); it != spans.constEnd(); ++it) {
+        result.append({it.key(), it.value()});
+    }
+    return result;
+}
+
+QList<ByteRange> RangeSet::missing(qint64 size) const {
+    QList<ByteRange> result;
+    qint64 cursor = 0;
+    for (auto it = spans.constBegin(); it != spans.constEnd() && cursor < size; ++it) {
+        if (it.key() > cursor) {
+            result.append({cursor, qMin(it.key(), size) - 1});
+        }
+        cursor = qMax(cursor, it.value() + 1);
+    }
+    if (cursor < size) {
+        result.append({cursor, size - 1});
+    }
+    return result;
+}
@@ -0,0 +1,33 @@
+#ifndef RANGESET_H
+#define RANGESET_H
+
+#include <QList>
+#include <QMap>
+
+struct ByteRange {
+    qint64 start;
+    qint64 end;
+
+    qint64 length() const { return end - start + 1; }
+};
+
+// Sorted set of disjoint inclusive byte ranges; adjacent ranges are merged.
+class RangeSet {
+public:
+    void add(qint64 start, qint64 end);
+    void remove(qint64 start, qint64 end);
+    void clear();
+
+    bool isEmpty() const;
+    bool contains(qint64 start, qint64 end) const;
+    qint64 totalLength() const;
+
+    QList<ByteRange> ranges() const;
+    // Ranges of [0, size) not covered by the set.
+    QList<ByteRange> missing(qint64 size) const;
+
+private:
+    QMap<qint64, qint64> spans;
+};
+
+#endif
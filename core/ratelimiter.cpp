@@ -0,0 +1,71 @@
+#include "ratelimiter.h"
+#include <QMutexLocker>
+#include <cmath>
+
+// The bucket holds a quarter of a second of traffic, and never less than one
+// read, so short bursts are smoothed without starving large reads.
+static const double BurstSeconds = 0.25;
+static const qint64 MinimumBurst = 64 * 1024;
+
+RateLimiter::RateLimiter(RateLimiter *parent) : parentLimiter(parent), bytesPerSecond(0), tokens(0) {
+    clock.start();
+}
+
+RateLimiter *RateLimiter::global() {
+    static RateLimiter limiter;
+    return &limiter;
+}
+
+void RateLimiter::setRate(qint64 rate) {
+    QMutexLocker locker(&mutex);
+    refill();
+    bytesPerSecond = qMax<qint64>(0, rate);
+    tokens = 0;
+}
+
+qint64 RateLimiter::rate() const {
+    QMutexLocker locker(&mutex);
+    return bytesPerSecond;
+}
+
+void RateLimiter::refill() {
+    qint64 elapsed = clock.restart();
+    if (bytesPerSecond <= 0) {
+        return;
+    }
+    double burst = qMax<double>(bytesPerSecond * BurstSeconds, MinimumBurst);
+    tokens = qMin(burst, tokens + elapsed * bytesPerSecond / 1000.0);
+}
+
+qint64 RateLimiter::acquire(qint64 wanted) {
+    QMutexLocker locker(&mutex);
+
+    qint64 granted = wanted;
+    if (bytesPerSecond > 0) {
+        refill();
+        granted = qMin<qint64>(granted, qint64(tokens));
+    }
+    if (granted > 0 && parentLimiter) {
+        granted = parentLimiter->acquire(granted);
+    }
+    if (bytesPerSecond > 0) {
+        tokens -= granted;
+    }
+    return granted;
+}
+
+int RateLimiter::delayFor(qint64 wanted) const {
+    int delay = 0;
+    {
+        QMutexLocker locker(&mutex);
+        if (bytesPerSecond > 0) {
+            double burst = qMax<double>(bytesPerSecond * BurstSeconds, MinimumBurst);
+            double missing = qMin<double>(wanted, burst) - tokens;
+            delay = int(std::ceil(missing * 1000.0 / bytesPerSecond));
+        }
+    }
+    if (parentLimiter) {
+        delay = qMax(delay, parentLimiter->delayFor(wanted));
+    }
+    return qBound(5, delay, 1000);
+}
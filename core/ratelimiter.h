@@ -0,0 +1,34 @@
+#ifndef RATELIMITER_H
+#define RATELIMITER_H
+
+#include <QElapsedTimer>
+#include <QMutex>
+
+// Token bucket shared by the readers of every connection. A limiter can have
+// a parent (e.g. a job limiter under the global one); bytes are only granted
+// when both have tokens. A rate of 0 means unlimited.
+class RateLimiter {
+public:
+    explicit RateLimiter(RateLimiter *parent = nullptr);
+
+    static RateLimiter *global();
+
+    void setRate(qint64 bytesPerSecond);
+    qint64 rate() const;
+
+    // Grants up to wanted bytes right now, possibly 0.
+    qint64 acquire(qint64 wanted);
+    // Milliseconds to wait before asking again for wanted bytes.
+    int delayFor(qint64 wanted) const;
+
+private:
+    void refill();
+
+    RateLimiter *parentLimiter;
+    mutable QMutex mutex;
+    qint64 bytesPerSecond;
+    double tokens;
+    QElapsedTimer clock;
+};
+
+#endif
@@ -0,0 +1,295 @@
+#include "segmentscheduler.h"
+#include <algorithm>
+#include <limits>
+
+// Rates measured over less than this are too noisy to call a segment a straggler.
+static const qint64 MinimumRateSampleMs = 1000;
+
+SegmentScheduler::SegmentScheduler(qint64 minimumSplit) : minimumSplit(minimumSplit), frontSlice(0), window(0), cursor(0) {}
+
+void SegmentScheduler::reset(const QList<Range> &ranges, int sliceCount) {
+    pending = ranges;
+    cursor = 0;
+    active.clear();
+
+    while (pending.size() < sliceCount) {
+        int largest = 0;
+        for (int i = 1; i < pending.size(); ++i) {
+            if (pending[i].length() > pending[largest].length()) {
+                largest = i;
+            }
+        }
+        if (pending.isEmpty() || pending[largest].length() < 2 * minimumSplit) {
+            break;
+        }
+
+        Range &range = pending[largest];
+        qint64 middle = range.start + range.length() / 2;
+        Range tail = {middle, range.end};
+        range.end = middle - 1;
+        pending.insert(largest + 1, tail);
+    }
+
+    if (frontSlice <= 0) {
+        return;
+    }
+    // Equal pieces, in order: workers then move through the file together.
+    QList<Range> sliced;
+    for (const Range &range : pending) {
+        qint64 pieces = (range.length() + frontSlice - 1) / frontSlice;
+        qint64 start = range.start;
+        for (qint64 i = 0; i < pieces; ++i) {
+            qint64 end = range.start + range.length() * (i + 1) / pieces - 1;
+            sliced.append({start, end});
+            start = end + 1;
+        }
+    }
+    pending = sliced;
+}
+
+void SegmentScheduler::enqueue(qint64 start, qint64 end) {
+    if (end < start) {
+        return;
+    }
+    int index = pending.size();
+    if (frontSlice > 0) {
+        index = 0;
+        while (index < pending.size() && pending[index].start < start) {
+            index++;
+        }
+    }
+    pending.insert(index, {start, end});
+}
+
+void SegmentScheduler::setFrontFirst(qint64 sliceLength) {
+    frontSlice = qMax<qint64>(0, sliceLength);
+}
+
+void SegmentScheduler::setWindow(qint64 window) {
+    this->window = qMax<qint64>(0, window);
+}
+
+void SegmentScheduler::setCursor(qint64 position) {
+    cursor = position;
+}
+
+bool SegmentScheduler::next(int worker, Range &range, int &victim) {
+    victim = -1;
+
+    if (!pending.isEmpty() && (window <= 0 || pending.first().start < cursor + window)) {
+        range = pending.takeFirst();
+    } else {
+        victim = pickVictim();
+        if (victim < 0) {
+            return false;
+        }
+
+        // Split what the victim has not reached yet in half; it keeps the head.
+        Segment &slow = active[victim];
+        qint64 cursor = slow.range.start + slow.received;
+        qint64 remaining = slow.range.end - cursor + 1;
+        range.start = cursor + remaining / 2;
+        range.end = slow.range.end;
+        slow.range.end = range.start - 1;
+    }
+
+    Segment segment;
+    segment.range = range;
+    segment.received = 0;
+    segment.timer.start();
+    active.insert(worker, segment);
+    return true;
+}
+
+SegmentScheduler::Range SegmentScheduler::claim(int worker, qint64 start) {
+    Range range = {start, start};
+    for (int i = 0; i < pending.size(); ++i) {
+        if (pending[i].start == start) {
+            range = pending.takeAt(i);
+            break;
+        }
+    }
+
+    Segment segment;
+    segment.range = range;
+    segment.received = 0;
+    segment.timer.start();
+    active.insert(worker, segment);
+    return range;
+}
+
+bool SegmentScheduler::hedge(int worker, qint64 endgameBytes, double stragglerRatio, Range &range, int &original) {
+    // Bytes per ms of every segment measured long enough, for the median.
+    QVector<double> rates;
+    qint64 inFlight = 0;
+    for (const Segment &segment : active) {
+        if (segment.cancelled) {
+            continue;
+        }
+        inFlight += segment.range.length() - segment.received;
+        qint64 elapsed = segment.timer.elapsed();
+        if (elapsed >= MinimumRateSampleMs) {
+            rates.append(double(segment.received) / elapsed);
+        }
+    }
+    double median = 0;
+    if (!rates.isEmpty()) {
+        std::nth_element(rates.begin(), rates.begin() + rates.size() / 2, rates.end());
+        median = rates[rates.size() / 2];
+    }
+    bool endgame = inFlight <= endgameBytes;
+
+    original = -1;
+    double slowestEta = -1;
+    for (auto it = active.constBegin(); it != active.constEnd(); ++it) {
+        const Segment &segment = it.value();
+        if (segment.partner >= 0 || segment.cancelled || segment.received >= segment.range.length()) {
+            continue;
+        }
+        qint64 elapsed = segment.timer.elapsed();
+        bool straggler = elapsed >= MinimumRateSampleMs
+                         && double(segment.received) / elapsed < stragglerRatio * median;
+        if (!endgame && !straggler) {
+            continue;
+        }
+        double eta = etaOf(segment);
+        if (eta > slowestEta) {
+            slowestEta = eta;
+            original = it.key();
+        }
+    }
+    if (original < 0) {
+        return false;
+    }
+
+    Segment &slow = active[original];
+    range.start = slow.range.start + slow.received;
+    range.end = slow.range.end;
+    slow.partner = worker;
+    slow.overlap = range.start;
+
+    Segment segment;
+    segment.range = range;
+    segment.received = 0;
+    segment.timer.start();
+    segment.partner = original;
+    segment.overlap = range.start;
+    active.insert(worker, segment);
+    return true;
+}
+
+double SegmentScheduler::etaOf(const Segment &segment) {
+    // Estimated time to finish at the segment's own rate so far.
+    qint64 remaining = segment.range.length() - segment.received;
+    qint64 elapsed = qMax<qint64>(segment.timer.elapsed(), 1);
+    return (segment.received > 0) ? remaining * double(elapsed) / segment.received
+                                  : std::numeric_limits<double>::max();
+}
+
+int SegmentScheduler::pickVictim() const {
+    int victim = -1;
+    double slowestEta = -1;
+
+    for (auto it = active.constBegin(); it != active.constEnd(); ++it) {
+        const Segment &segment = it.value();
+        qint64 remaining = segment.range.length() - segment.received;
+        // Racing workers must keep the tail they share.
+        if (remaining / 2 < minimumSplit || segment.partner >= 0 || segment.cancelled) {
+            continue;
+        }
+
+        double eta = etaOf(segment);
+        if (eta > slowestEta) {
+            slowestEta = eta;
+            victim = it.key();
+        }
+    }
+    return victim;
+}
+
+void SegmentScheduler::updateProgress(int worker, qint64 received) {
+    auto it = active.find(worker);
+    if (it != active.end()) {
+        it->received = qMin(received, it->range.length());
+    }
+}
+
+SegmentScheduler::Range SegmentScheduler::finish(int worker, int *loser) {
+    Segment segment = active.take(worker);
+    if (loser) {
+        *loser = segment.partner;
+    }
+
+    auto partner = active.find(segment.partner);
+    if (partner == active.end()) {
+        return segment.range;
+    }
+    // The original's head is on disk too: the pair covers both ranges.
+    partner->cancelled = true;
+    partner->partner = -1;
+    return {qMin(segment.range.start, partner->range.start), segment.range.end};
+}
+
+SegmentScheduler::Range SegmentScheduler::abandon(int worker, qint64 &duplicate) {
+    Segment segment = active.take(worker);
+    duplicate = 0;
+    if (segment.overlap < 0) {
+        return segment.range;
+    }
+
+    // Bytes at or past the shared tail were also counted by the other copy.
+    qint64 reached = segment.range.start + segment.received;
+    duplicate = qMax<qint64>(0, reached - qMax(segment.overlap, segment.range.start));
+
+    auto partner = active.find(segment.partner);
+    if (partner != active.end()) {
+        partner->partner = -1;
+        partner->overlap = -1;
+    }
+    return {segment.range.start, segment.overlap - 1};
+}
+
+qint64 SegmentScheduler::release(int worker, qint64 keep) {
+    auto it = active.find(worker);
+    if (it == active.end()) {
+        return -1;
+    }
+    if (it->partner >= 0 || it->cancelled) {
+        return it->range.end;
+    }
+
+    qint64 end = it->range.start + it->received + keep - 1;
+    if (end < it->range.end) {
+        enqueue(end + 1, it->range.end);
+        it->range.end = end;
+    }
+    return it->range.end;
+}
+
+SegmentScheduler::Range SegmentScheduler::rangeOf(int worker) const {
+    return active.value(worker).range;
+}
+
+qint64 SegmentScheduler::receivedOf(int worker) const {
+    return active.value(worker).received;
+}
+
+bool SegmentScheduler::isActive(int worker) const {
+    return active.contains(worker);
+}
+
+bool SegmentScheduler::isRacing(int worker) const {
+    return active.value(worker).partner >= 0;
+}
+
+bool SegmentScheduler::isCancelled(int worker) const {
+    return active.value(worker).cancelled;
+}
+
+int SegmentScheduler::activeCount() const {
+    return active.size();
+}
+
+bool SegmentScheduler::hasPending() const {
+    return !pending.isEmpty();
+}
@@ -0,0 +1,90 @@
+#ifndef SEGMENTSCHEDULER_H
+#define SEGMENTSCHEDULER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include "rangeset.h"
+
+// Hands byte ranges out to workers. Ranges come from a pending queue; once it
+// is empty, an idle worker takes the untouched tail of the in-flight range that
+// is expected to finish last. When that tail is too small to split, hedge()
+// lets an idle worker race the straggler for it instead.
+class SegmentScheduler {
+public:
+    using Range = ByteRange;
+
+    explicit SegmentScheduler(qint64 minimumSplit = 1024 * 1024);
+
+    // Queues the given ranges, halving the largest until there are at least
+    // sliceCount of them.
+    void reset(const QList<Range> &ranges, int sliceCount);
+    void enqueue(qint64 start, qint64 end);
+    // Front first: reset() also cuts ranges to at most sliceLength bytes, and
+    // pending ranges are handed out lowest offset first, so the file fills in
+    // from its start for a reader of the contiguous prefix. 0 disables it.
+    void setFrontFirst(qint64 sliceLength);
+    // Read-ahead window for a reader at cursor: pending ranges that start
+    // window bytes or more past it stay queued, and idle workers split ranges
+    // in flight instead. 0 disables it. reset() puts the cursor back at 0.
+    void setWindow(qint64 window);
+    void setCursor(qint64 position);
+
+    // Returns false when there is nothing to hand out now. If the range was
+    // split off another worker, victim is set to that worker, whose range now
+    // ends at range.start - 1; otherwise victim is -1.
+    bool next(int worker, Range &range, int &victim);
+    // Gives worker the pending range that begins at start, for a worker that
+    // is already fetching from there. If no range begins there, the worker
+    // only gets that one byte.
+    Range claim(int worker, qint64 start);
+    // Endgame: gives worker a copy of the unfinished tail of the segment
+    // expected to finish last, once at most endgameBytes are left in flight or
+    // when that segment runs below stragglerRatio times the median rate. The
+    // two workers race; original is set to the one being copied.
+    bool hedge(int worker, qint64 endgameBytes, double stragglerRatio, Range &range, int &original);
+    void updateProgress(int worker, qint64 received);
+    // Returns the range now complete: for the winner of a race, everything
+    // both workers shared. The loser is then cancelled: it stays active, and
+    // returned in loser, until abandon() is called for it.
+    Range finish(int worker, int *loser = nullptr);
+    // Takes worker off its range: it was cancelled, or failed while racing and
+    // its partner carries on alone. Returns the bytes only it was fetching,
+    // possibly none; duplicate is set to the bytes it received that the other
+    // copy also counts.
+    Range abandon(int worker, qint64 &duplicate);
+    // Gives back everything past the next keep bytes of the worker's range to
+    // the queue and returns the worker's new end.
+    qint64 release(int worker, qint64 keep);
+
+    Range rangeOf(int worker) const;
+    qint64 receivedOf(int worker) const;
+    bool isActive(int worker) const;
+    // Racing another worker for the same tail, or cancelled after losing.
+    bool isRacing(int worker) const;
+    bool isCancelled(int worker) const;
+    int activeCount() const;
+    bool hasPending() const;
+
+private:
+    struct Segment {
+        Range range;
+        qint64 received;
+        QElapsedTimer timer;
+        int partner = -1;           // the other worker fetching the same tail
+        qint64 overlap = -1;        // first byte of that shared tail
+        bool cancelled = false;
+    };
+
+    int pickVictim() const;
+    static double etaOf(const Segment &segment);
+
+    QList<Range> pending;
+    QHash<int, Segment> active;
+    qint64 minimumSplit;
+    qint64 frontSlice;
+    qint64 window;
+    qint64 cursor;
+};
+
+#endif
@@ -0,0 +1,800 @@
+#include "streamextractor.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <cstring>
+
+#ifdef FASTDOMS_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef FASTDOMS_HAVE_LZMA
+#include <lzma.h>
+#endif
+
+// Bytes of the file handed to one job: a reset, or a longer prefix, is
+// noticed between jobs.
+static const qint64 JobBytes = 16 * 1024 * 1024;
+static const qint64 ReadSize = 1024 * 1024;
+static const int OutputSize = 256 * 1024;
+static const int TarBlock = 512;
+// Enough to tell gzip from xz from anything else.
+static const qint64 MagicBytes = 6;
+// pax headers and GNU long names are kept in memory.
+static const qint64 MaxMetadataBytes = 1024 * 1024;
+
+static bool isZeroBlock(const char *block) {
+    for (int i = 0; i < TarBlock; ++i) {
+        if (block[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Octal, padded with spaces or NULs; GNU base-256 when the high bit is set.
+static qint64 tarNumber(const char *field, int size) {
+    qint64 value = 0;
+    if (uchar(field[0]) & 0x80) {
+        value = uchar(field[0]) & 0x7f;
+        for (int i = 1; i < size; ++i) {
+            value = (value << 8) | uchar(field[i]);
+        }
+        return value;
+    }
+    int i = 0;
+    while (i < size && (field[i] == ' ' || field[i] == '\0')) {
+        i++;
+    }
+    for (; i < size && field[i] >= '0' && field[i] <= '7'; ++i) {
+        value = value * 8 + (field[i] - '0');
+    }
+    return value;
+}
+
+static QString tarString(const char *field, int size) {
+    return QString::fromUtf8(field, qstrnlen(field, size));
+}
+
+static QFile::Permissions permissionsOf(qint64 mode) {
+    QFile::Permissions permissions;
+    if (mode & 0400) permissions |= QFile::ReadOwner | QFile::ReadUser;
+    if (mode & 0200) permissions |= QFile::WriteOwner | QFile::WriteUser;
+    if (mode & 0100) permissions |= QFile::ExeOwner | QFile::ExeUser;
+    if (mode & 0040) permissions |= QFile::ReadGroup;
+    if (mode & 0020) permissions |= QFile::WriteGroup;
+    if (mode & 0010) permissions |= QFile::ExeGroup;
+    if (mode & 0004) permissions |= QFile::ReadOther;
+    if (mode & 0002) permissions |= QFile::WriteOther;
+    if (mode & 0001) permissions |= QFile::ExeOther;
+    return permissions;
+}
+
+// Unpacks a tar stream (ustar, with pax headers and GNU long names) as it
+// arrives. Nothing is written outside the directory: absolute names are made
+// relative, and ".." or a symbolic link leading out of it is refused.
+class TarWriter {
+public:
+    explicit TarWriter(const QString &directory);
+
+    bool write(const char *data, qint64 size, QString *error);
+    bool finish(QString *error);
+    int entries() const { return entryCount; }
+
+private:
+    enum Target { Discard, File, Collect };
+
+    bool onHeader(QString *error);
+    bool finishContent(QString *error);
+    QString safePath(const QString &name, QString *error) const;
+    bool isInside(const QString &canonical) const;
+
+    QString root;
+    QString canonicalRoot;
+    QByteArray header;
+    Target target = Discard;
+    qint64 remaining = 0;       // content bytes of the entry still to come
+    qint64 padding = 0;
+    char collectType = 0;
+    QByteArray collected;
+    // From pax headers or GNU long names, for the next entry.
+    QString nextName;
+    QString nextLink;
+    qint64 nextSize = -1;
+    QFile file;
+    QFile::Permissions filePermissions;
+    qint64 fileTime = 0;
+    int zeroBlocks = 0;
+    bool ended = false;
+    int entryCount = 0;
+};
+
+TarWriter::TarWriter(const QString &directory) : root(QDir(directory).absolutePath()) {
+    QDir().mkpath(root);
+    canonicalRoot = QFileInfo(root).canonicalFilePath();
+}
+
+bool TarWriter::write(const char *data, qint64 size, QString *error) {
+    while (size > 0 && !ended) {
+        if (remaining > 0) {
+            qint64 count = qMin(remaining, size);
+            if (target == File && file.write(data, count) != count) {
+                *error = file.errorString();
+                return false;
+            }
+            if (target == Collect) {
+                collected.append(data, count);
+            }
+            data += count;
+            size -= count;
+            remaining -= count;
+            if (remaining == 0 && !finishContent(error)) {
+                return false;
+            }
+            continue;
+        }
+        if (padding > 0) {
+            qint64 count = qMin(padding, size);
+            data += count;
+            size -= count;
+            padding -= count;
+            continue;
+        }
+
+        qint64 count = qMin<qint64>(TarBlock - header.size(), size);
+        header.append(data, count);
+        data += count;
+        size -= count;
+        if (header.size() == TarBlock) {
+            bool ok = onHeader(error);
+            header.clear();
+            if (!ok) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool TarWriter::finish(QString *error) {
+    // Some writers leave out the two zero blocks at the end: an archive that
+    // stops between entries is accepted.
+    if (remaining > 0 || !header.isEmpty()) {
+        *error = "archive tar tronquée";
+        return false;
+    }
+    return true;
+}
+
+bool TarWriter::onHeader(QString *error) {
+    const char *h = header.constData();
+    if (isZeroBlock(h)) {
+        if (++zeroBlocks == 2) {
+            ended = true;
+        }
+        return true;
+    }
+    zeroBlocks = 0;
+
+    // The checksum is taken with its own field as spaces.
+    qint64 sum = 0;
+    for (int i = 0; i < TarBlock; ++i) {
+        sum += (i >= 148 && i < 156) ? ' ' : uchar(h[i]);
+    }
+    if (sum != tarNumber(h + 148, 8)) {
+        *error = "en-tête tar invalide";
+        return false;
+    }
+
+    char type = h[156];
+    bool metadata = type == 'x' || type == 'g' || type == 'L' || type == 'K';
+    qint64 size = !metadata && nextSize >= 0 ? nextSize : tarNumber(h + 124, 12);
+    remaining = size;
+    padding = (TarBlock - size % TarBlock) % TarBlock;
+
+    if (metadata) {
+        if (size > MaxMetadataBytes) {
+            *error = "en-tête tar étendu trop grand";
+            return false;
+        }
+        // Global pax headers only hold defaults this does not use.
+        target = type == 'g' ? Discard : Collect;
+        collectType = type;
+        collected.clear();
+        return remaining > 0 || finishContent(error);
+    }
+
+    QString name = nextName;
+    if (name.isEmpty()) {
+        name = tarString(h, 100);
+        QString prefix = std::memcmp(h + 257, "ustar", 5) == 0 ? tarString(h + 345, 155) : QString();
+        if (!prefix.isEmpty()) {
+            name = prefix + '/' + name;
+        }
+    }
+    QString link = nextLink.isEmpty() ? tarString(h + 157, 100) : nextLink;
+    nextName.clear();
+    nextLink.clear();
+    nextSize = -1;
+
+    QString path = safePath(name, error);
+    if (path.isEmpty()) {
+        return false;
+    }
+    entryCount++;
+    target = Discard;
+
+    switch (type) {
+    case '5':
+        QDir().mkpath(path);
+        break;
+    case '2': {
+        // Only relative targets that stay in the directory: a later entry
+        // could otherwise read or write through the link. ".." only leads,
+        // so no link met on the way down can climb back out.
+        bool climbing = true;
+        bool contained = !link.isEmpty() && !QDir::isAbsolutePath(link);
+        for (const QString &part : link.split('/', Qt::SkipEmptyParts)) {
+            if (part != "..") {
+                climbing = false;
+            } else if (!climbing) {
+                contained = false;
+            }
+        }
+        QString canonicalParent = QFileInfo(QFileInfo(path).absolutePath()).canonicalFilePath();
+        if (!contained || !isInside(QDir::cleanPath(canonicalParent + '/' + link))) {
+            *error = "lien symbolique refusé dans l'archive: " + name + " -> " + link;
+            return false;
+        }
+        QFile::remove(path);
+        if (!QFile::link(link, path)) {
+            *error = "impossible de créer le lien " + name;
+            return false;
+        }
+        break;
+    }
+    case '1': {
+        // The copy follows links: its source must itself be inside.
+        QString source = safePath(link, error);
+        if (source.isEmpty()) {
+            return false;
+        }
+        if (!QFileInfo::exists(source)) {
+            *error = "cible du lien introuvable: " + link;
+            return false;
+        }
+        if (QFileInfo(source).isSymLink() || !isInside(QFileInfo(source).canonicalFilePath())) {
+            *error = "lien physique refusé dans l'archive: " + name + " -> " + link;
+            return false;
+        }
+        QFile::remove(path);
+        if (!QFile::copy(source, path)) {
+            *error = "cible du lien introuvable: " + link;
+            return false;
+        }
+        break;
+    }
+    case '0':
+    case '\0':
+    case '7':
+        // Replaces whatever is there, a symbolic link included.
+        QFile::remove(path);
+        file.setFileName(path);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            *error = file.errorString();
+            return false;
+        }
+        filePermissions = permissionsOf(tarNumber(h + 100, 8));
+        fileTime = tarNumber(h + 136, 12);
+        target = File;
+        break;
+    default:
+        // Devices and FIFOs are skipped.
+        break;
+    }
+    return remaining > 0 || finishContent(error);
+}
+
+bool TarWriter::finishContent(QString *error) {
+    if (target == File) {
+        file.setFileTime(QDateTime::fromSecsSinceEpoch(fileTime), QFileDevice::FileModificationTime);
+        file.close();
+        if (file.error() != QFileDevice::NoError) {
+            *error = file.errorString();
+            return false;
+        }
+        file.setPermissions(filePermissions);
+    } else if (target == Collect) {
+        if (collectType == 'L' || collectType == 'K') {
+            QString value = QString::fromUtf8(collected.constData(), qstrnlen(collected.constData(), collected.size()));
+            (collectType == 'L' ? nextName : nextLink) = value;
+        } else {
+            // Records are "<length> <key>=<value>\n", length counting the whole record.
+            qint64 position = 0;
+            while (position < collected.size()) {
+                int space = collected.indexOf(' ', position);
+                qint64 length = space > 0 ? collected.mid(position, space - position).toLongLong() : 0;
+                if (length <= 0 || position + length > collected.size()) {
+                    break;
+                }
+                QByteArray record = collected.mid(space + 1, position + length - space - 2);
+                int equals = record.indexOf('=');
+                QByteArray key = record.left(equals);
+                QByteArray value = record.mid(equals + 1);
+                if (key == "path") {
+                    nextName = QString::fromUtf8(value);
+                } else if (key == "linkpath") {
+                    nextLink = QString::fromUtf8(value);
+                } else if (key == "size") {
+                    nextSize = value.toLongLong();
+                }
+                position += length;
+            }
+        }
+        collected.clear();
+    }
+    target = Discard;
+    return true;
+}
+
+QString TarWriter::safePath(const QString &name, QString *error) const {
+    QString relative = QDir::cleanPath(name);
+    while (relative.startsWith('/')) {
+        relative.remove(0, 1);
+    }
+    if (relative == ".." || relative.startsWith("../")) {
+        *error = "chemin refusé dans l'archive: " + name;
+        return QString();
+    }
+    QString path = relative.isEmpty() || relative == "." ? root : root + '/' + relative;
+    if (path == root) {
+        return path;
+    }
+
+    // Checked on the deepest directory that already exists, before mkpath
+    // creates the rest: a symlink on the way could lead it outside.
+    QString parent = QFileInfo(path).absolutePath();
+    QString existing = parent;
+    while (!QFileInfo::exists(existing) && !QFileInfo(existing).isSymLink()) {
+        existing = QFileInfo(existing).absolutePath();
+    }
+    if (!isInside(QFileInfo(existing).canonicalFilePath())) {
+        *error = "chemin refusé dans l'archive: " + name;
+        return QString();
+    }
+    QDir().mkpath(parent);
+    if (!isInside(QFileInfo(parent).canonicalFilePath())) {
+        *error = "chemin refusé dans l'archive: " + name;
+        return QString();
+    }
+    return path;
+}
+
+bool TarWriter::isInside(const QString &canonical) const {
+    return !canonical.isEmpty() && (canonical == canonicalRoot || canonical.startsWith(canonicalRoot + '/'));
+}
+
+// Decoder state of one extraction, only touched by one job at a time.
+class ExtractionPipeline {
+public:
+    ExtractionPipeline(const QString &path, const QString &directory, const QString &name);
+    ~ExtractionPipeline();
+
+    // Feeds bytes start..end - 1 of the file; last ends the stream.
+    bool feed(qint64 start, qint64 end, bool last, QString *error);
+    QString summary() const;
+
+private:
+    enum Codec { Unknown, Plain, Gzip, Xz };
+
+    bool pickCodec(const char *data, qint64 size, QString *error);
+    bool decode(const char *data, qint64 size, QString *error);
+    bool finishDecoding(QString *error);
+    // Decompressed bytes: the first block tells a tar archive from a plain file.
+    bool output(const char *data, qint64 size, QString *error);
+    // Opens where they go, then writes the bytes kept until then.
+    bool flushHead(QString *error);
+    bool writeSink(const char *data, qint64 size, QString *error);
+    bool finishOutput(QString *error);
+
+    QFile input;
+    QString directory;
+    QString name;
+    Codec codec = Unknown;
+    QByteArray outputHead;
+    bool sinkChosen = false;
+    std::unique_ptr<TarWriter> tar;
+    QFile plain;
+    qint64 outputBytes = 0;
+    QByteArray chunk;
+#ifdef FASTDOMS_HAVE_ZLIB
+    z_stream zstream;
+    bool zlibReady = false;
+    bool memberEnded = false;   // between gzip members
+    bool trailing = false;      // garbage after the last member, ignored like gzip does
+#endif
+#ifdef FASTDOMS_HAVE_LZMA
+    lzma_stream xzstream = LZMA_STREAM_INIT;
+    bool xzEnded = false;
+#endif
+};
+
+ExtractionPipeline::ExtractionPipeline(const QString &path, const QString &directory, const QString &name)
+    : input(path), directory(directory), name(name), chunk(OutputSize, Qt::Uninitialized) {
+#ifdef FASTDOMS_HAVE_ZLIB
+    std::memset(&zstream, 0, sizeof(zstream));
+#endif
+}
+
+ExtractionPipeline::~ExtractionPipeline() {
+#ifdef FASTDOMS_HAVE_ZLIB
+    if (zlibReady) {
+        inflateEnd(&zstream);
+    }
+#endif
+#ifdef FASTDOMS_HAVE_LZMA
+    lzma_end(&xzstream);
+#endif
+}
+
+bool ExtractionPipeline::feed(qint64 start, qint64 end, bool last, QString *error) {
+    if (!input.isOpen() && !input.open(QIODevice::ReadOnly)) {
+        *error = input.errorString();
+        return false;
+    }
+    if (!input.seek(start)) {
+        *error = input.errorString();
+        return false;
+    }
+
+    QByteArray buffer(ReadSize, Qt::Uninitialized);
+    qint64 position = start;
+    while (position < end) {
+        qint64 read = input.read(buffer.data(), qMin(ReadSize, end - position));
+        if (read <= 0) {
+            *error = "lecture du fichier impossible pendant l'extraction";
+            return false;
+        }
+        if (codec == Unknown && !pickCodec(buffer.constData(), read, error)) {
+            return false;
+        }
+        if (!decode(buffer.constData(), read, error)) {
+            return false;
+        }
+        position += read;
+    }
+
+    if (!last) {
+        return true;
+    }
+    if (codec == Unknown && !pickCodec(nullptr, 0, error)) {
+        return false;
+    }
+    return finishDecoding(error) && finishOutput(error);
+}
+
+QString ExtractionPipeline::summary() const {
+    if (tar) {
+        return QString("%1 élément(s) extrait(s) dans %2").arg(tar->entries()).arg(directory);
+    }
+    return QString("%1 décompressé (%2 octets)").arg(plain.fileName()).arg(outputBytes);
+}
+
+bool ExtractionPipeline::pickCodec(const char *data, qint64 size, QString *error) {
+    const uchar *bytes = reinterpret_cast<const uchar *>(data);
+    if (size >= 2 && bytes[0] == 0x1f && bytes[1] == 0x8b) {
+#ifdef FASTDOMS_HAVE_ZLIB
+        // 16: gzip wrapper, not zlib's.
+        if (inflateInit2(&zstream, 15 + 16) != Z_OK) {
+            *error = "initialisation de zlib impossible";
+            return false;
+        }
+        zlibReady = true;
+        codec = Gzip;
+        return true;
+#else
+        *error = "gzip non pris en charge (compilé sans zlib)";
+        return false;
+#endif
+    }
+    if (size >= MagicBytes && std::memcmp(data, "\xfd" "7zXZ\0", MagicBytes) == 0) {
+#ifdef FASTDOMS_HAVE_LZMA
+        if (lzma_stream_decoder(&xzstream, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK) {
+            *error = "initialisation de liblzma impossible";
+            return false;
+        }
+        codec = Xz;
+        return true;
+#else
+        *error = "xz non pris en charge (compilé sans liblzma)";
+        return false;
+#endif
+    }
+    codec = Plain;
+    return true;
+}
+
+bool ExtractionPipeline::decode(const char *data, qint64 size, QString *error) {
+    switch (codec) {
+    case Plain:
+        return output(data, size, error);
+#ifdef FASTDOMS_HAVE_ZLIB
+    case Gzip: {
+        Bytef *out = reinterpret_cast<Bytef *>(chunk.data());
+        zstream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+        zstream.avail_in = uInt(size);
+        // A full output buffer may leave more output pending with no input left.
+        bool full = false;
+        while ((zstream.avail_in > 0 || full) && !trailing) {
+            if (memberEnded) {
+                // Another member may follow (pigz, bgzip).
+                if (zstream.avail_in == 0) {
+                    break;
+                }
+                if (*zstream.next_in != 0x1f) {
+                    trailing = true;
+                    break;
+                }
+                memberEnded = false;
+            }
+            zstream.next_out = out;
+            zstream.avail_out = OutputSize;
+            int result = inflate(&zstream, Z_NO_FLUSH);
+            if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+                *error = QString("données gzip invalides (%1)").arg(zstream.msg ? zstream.msg : "");
+                return false;
+            }
+            qint64 produced = OutputSize - zstream.avail_out;
+            if (produced > 0 && !output(chunk.constData(), produced, error)) {
+                return false;
+            }
+            full = zstream.avail_out == 0;
+            if (result == Z_STREAM_END) {
+                inflateReset(&zstream);
+                memberEnded = true;
+                full = false;
+            }
+        }
+        return true;
+    }
+#endif
+#ifdef FASTDOMS_HAVE_LZMA
+    case Xz: {
+        uint8_t *out = reinterpret_cast<uint8_t *>(chunk.data());
+        xzstream.next_in = reinterpret_cast<const uint8_t *>(data);
+        xzstream.avail_in = size_t(size);
+        bool full = false;
+        while ((xzstream.avail_in > 0 || full) && !xzEnded) {
+            xzstream.next_out = out;
+            xzstream.avail_out = OutputSize;
+            lzma_ret result = lzma_code(&xzstream, LZMA_RUN);
+            qint64 produced = OutputSize - qint64(xzstream.avail_out);
+            if (produced > 0 && !output(chunk.constData(), produced, error)) {
+                return false;
+            }
+            if (result == LZMA_STREAM_END) {
+                xzEnded = true;
+                break;
+            }
+            if (result != LZMA_OK) {
+                *error = QString("données xz invalides (%1)").arg(int(result));
+                return false;
+            }
+            full = xzstream.avail_out == 0;
+        }
+        return true;
+    }
+#endif
+    default:
+        return true;
+    }
+}
+
+bool ExtractionPipeline::finishDecoding(QString *error) {
+#ifdef FASTDOMS_HAVE_ZLIB
+    if (codec == Gzip && !memberEnded) {
+        *error = "archive gzip tronquée";
+        return false;
+    }
+#endif
+#ifdef FASTDOMS_HAVE_LZMA
+    // Concatenated streams are only known to be over once told so.
+    uint8_t *out = reinterpret_cast<uint8_t *>(chunk.data());
+    while (codec == Xz && !xzEnded) {
+        xzstream.next_in = nullptr;
+        xzstream.avail_in = 0;
+        xzstream.next_out = out;
+        xzstream.avail_out = OutputSize;
+        lzma_ret result = lzma_code(&xzstream, LZMA_FINISH);
+        qint64 produced = OutputSize - qint64(xzstream.avail_out);
+        if (produced > 0 && !output(chunk.constData(), produced, error)) {
+            return false;
+        }
+        if (result == LZMA_STREAM_END) {
+            xzEnded = true;
+        } else if (result != LZMA_OK) {
+            *error = "archive xz tronquée";
+            return false;
+        }
+    }
+#endif
+    Q_UNUSED(error);
+    return true;
+}
+
+bool ExtractionPipeline::output(const char *data, qint64 size, QString *error) {
+    outputBytes += size;
+    if (sinkChosen) {
+        return writeSink(data, size, error);
+    }
+    outputHead.append(data, size);
+    return outputHead.size() < TarBlock || flushHead(error);
+}
+
+bool ExtractionPipeline::flushHead(QString *error) {
+    sinkChosen = true;
+    // Old v7 archives, without the ustar magic, are taken for plain files.
+    bool isTar = outputHead.size() >= TarBlock && std::memcmp(outputHead.constData() + 257, "ustar", 5) == 0;
+    if (isTar) {
+        tar = std::make_unique<TarWriter>(directory);
+    } else if (codec == Plain) {
+        *error = "ni archive tar ni fichier compressé (gzip, xz)";
+        return false;
+    } else {
+        QDir().mkpath(directory);
+        plain.setFileName(QDir(directory).filePath(name));
+        if (!plain.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            *error = plain.errorString();
+            return false;
+        }
+    }
+    QByteArray head = outputHead;
+    outputHead.clear();
+    return writeSink(head.constData(), head.size(), error);
+}
+
+bool ExtractionPipeline::writeSink(const char *data, qint64 size, QString *error) {
+    if (tar) {
+        return tar->write(data, size, error);
+    }
+    if (plain.write(data, size) != size) {
+        *error = plain.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool ExtractionPipeline::finishOutput(QString *error) {
+    if (!sinkChosen && !flushHead(error)) {
+        return false;
+    }
+    if (tar) {
+        return tar->finish(error);
+    }
+    plain.close();
+    if (plain.error() != QFileDevice::NoError) {
+        *error = plain.errorString();
+        return false;
+    }
+    return true;
+}
+
+StreamExtractor::StreamExtractor(QObject *parent)
+    : QObject(parent), generation(0), available(0), readBytes(0), requested(0), totalSize(-1),
+      inputComplete(false), jobRunning(false), running(false), done(false) {
+    pool.setObjectName("FastDoms extraction");
+    // Decoding is sequential; one thread keeps the jobs in order.
+    pool.setMaxThreadCount(1);
+}
+
+StreamExtractor::~StreamExtractor() {
+    // Running jobs post their results to this object: let them finish first.
+    pool.clear();
+    pool.waitForDone();
+}
+
+void StreamExtractor::start(const QString &path, const QString &directory, const QString &name) {
+    reset();
+    filePath = path;
+    outputDirectory = directory;
+    outputName = name;
+    pipeline = std::make_shared<ExtractionPipeline>(path, directory, name);
+    running = true;
+}
+
+void StreamExtractor::restart() {
+    if (running) {
+        start(filePath, outputDirectory, outputName);
+    }
+}
+
+void StreamExtractor::reset() {
+    pool.clear();
+    generation++;
+    pipeline.reset();
+    available = 0;
+    readBytes = 0;
+    requested = 0;
+    totalSize = -1;
+    inputComplete = false;
+    jobRunning = false;
+    running = false;
+    done = false;
+}
+
+bool StreamExtractor::isRunning() const {
+    return running;
+}
+
+void StreamExtractor::update(qint64 available) {
+    if (!running || done) {
+        return;
+    }
+    this->available = qMax(this->available, available);
+    schedule();
+}
+
+void StreamExtractor::finishInput(qint64 size) {
+    if (!running || done) {
+        return;
+    }
+    inputComplete = true;
+    totalSize = size;
+    available = size;
+    schedule();
+}
+
+bool StreamExtractor::isInputComplete() const {
+    return inputComplete;
+}
+
+qint64 StreamExtractor::consumed() const {
+    return jobRunning ? requested : readBytes;
+}
+
+bool StreamExtractor::isFinished() const {
+    return done;
+}
+
+void StreamExtractor::schedule() {
+    if (jobRunning || (!inputComplete && available - readBytes <= 0)) {
+        return;
+    }
+    if (!inputComplete && readBytes == 0 && available < MagicBytes) {
+        return;
+    }
+
+    qint64 start = readBytes;
+    qint64 end = qMin(available, readBytes + JobBytes);
+    bool last = inputComplete && end >= totalSize;
+    int jobGeneration = generation;
+    std::shared_ptr<ExtractionPipeline> job = pipeline;
+    jobRunning = true;
+    requested = end;
+
+    pool.start([this, job, start, end, last, jobGeneration]() {
+        QString message;
+        bool success = job->feed(start, end, last, &message);
+        if (success && last) {
+            message = job->summary();
+        }
+        QMetaObject::invokeMethod(this, [=]() {
+            onJobDone(jobGeneration, end, last, success, message);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void StreamExtractor::onJobDone(int generation, qint64 end, bool last, bool success, const QString &message) {
+    if (generation != this->generation || done) {
+        return;
+    }
+    jobRunning = false;
+    if (!success || last) {
+        done = true;
+        pipeline.reset();
+        emit finished(success, message);
+        return;
+    }
+    readBytes = end;
+    schedule();
+}
@@ -0,0 +1,66 @@
+#ifndef STREAMEXTRACTOR_H
+#define STREAMEXTRACTOR_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <memory>
+
+class ExtractionPipeline;
+
+// Decompresses (gzip, xz) and unpacks (tar) a download while it is still
+// running. Only the contiguous prefix of the file is on disk in order, so
+// each time it grows the new bytes are read back, while still in the page
+// cache, and fed to the decoder on a pool thread, one job at a time. A tar
+// archive is unpacked into the directory; anything else is decompressed into
+// it as one file.
+class StreamExtractor : public QObject {
+    Q_OBJECT
+
+public:
+    explicit StreamExtractor(QObject *parent = nullptr);
+    ~StreamExtractor();
+
+    // Reads path, the file being downloaded, into directory. name is used for
+    // a decompressed file that is not an archive.
+    void start(const QString &path, const QString &directory, const QString &name);
+    // Starts over from the first byte, e.g. after bytes already read were
+    // found corrupt and fetched again.
+    void restart();
+    // Forgets the current file; jobs still in flight are ignored.
+    void reset();
+    bool isRunning() const;
+
+    // Bytes [0, available) of the file are on disk.
+    void update(qint64 available);
+    // The file is complete at size bytes: the decoder is finished once it has
+    // read them all.
+    void finishInput(qint64 size);
+    bool isInputComplete() const;
+    // Bytes of the file read so far, or being read.
+    qint64 consumed() const;
+    bool isFinished() const;
+
+signals:
+    void finished(bool success, const QString &message);
+
+private:
+    void schedule();
+    void onJobDone(int generation, qint64 end, bool last, bool success, const QString &message);
+
+    QThreadPool pool;
+    QString filePath;
+    QString outputDirectory;
+    QString outputName;
+    std::shared_ptr<ExtractionPipeline> pipeline;
+    int generation;
+    qint64 available;
+    qint64 readBytes;
+    qint64 requested;               // end of the job in flight
+    qint64 totalSize;
+    bool inputComplete;
+    bool jobRunning;
+    bool running;
+    bool done;
+};
+
+#endif
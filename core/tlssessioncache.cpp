@@ -0,0 +1,38 @@
+#include "tlssessioncache.h"
+#include <QMutexLocker>
+#include <QUrl>
+
+// Lifetime assumed when the server gives none; servers rarely keep session
+// state longer.
+static const int DefaultLifetimeSecs = 300;
+
+static QString keyOf(const QUrl &url) {
+    return url.host() + ':' + QString::number(url.port(443));
+}
+
+TlsSessionCache *TlsSessionCache::instance() {
+    static TlsSessionCache cache;
+    return &cache;
+}
+
+QByteArray TlsSessionCache::ticket(const QUrl &url) {
+    QMutexLocker locker(&mutex);
+    auto it = tickets.find(keyOf(url));
+    if (it == tickets.end()) {
+        return QByteArray();
+    }
+    if (it->expiry <= QDateTime::currentDateTimeUtc()) {
+        tickets.erase(it);
+        return QByteArray();
+    }
+    return it->data;
+}
+
+void TlsSessionCache::store(const QUrl &url, const QByteArray &ticket, int lifetimeHint) {
+    if (ticket.isEmpty()) {
+        return;
+    }
+    QMutexLocker locker(&mutex);
+    int lifetime = lifetimeHint > 0 ? lifetimeHint : DefaultLifetimeSecs;
+    tickets.insert(keyOf(url), {ticket, QDateTime::currentDateTimeUtc().addSecs(lifetime)});
+}
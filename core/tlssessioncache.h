@@ -0,0 +1,35 @@
+#ifndef TLSSESSIONCACHE_H
+#define TLSSESSIONCACHE_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+class QUrl;
+
+// TLS session tickets by host and port, shared by every network manager of
+// the process. Qt only resumes sessions between connections of one manager;
+// with the ticket of an earlier handshake, a connection opened on another
+// I/O thread, or by a later download, resumes instead of doing a full one.
+class TlsSessionCache {
+public:
+    static TlsSessionCache *instance();
+
+    // Empty if none is known or it has expired.
+    QByteArray ticket(const QUrl &url);
+    // lifetimeHint in seconds, as announced by the server; 0 if unknown.
+    void store(const QUrl &url, const QByteArray &ticket, int lifetimeHint);
+
+private:
+    struct Ticket {
+        QByteArray data;
+        QDateTime expiry;
+    };
+
+    QMutex mutex;
+    QHash<QString, Ticket> tickets;
+};
+
+#endif
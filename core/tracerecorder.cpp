@@ -0,0 +1,154 @@
+#include "tracerecorder.h"
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMap>
+#include <QMutexLocker>
+#include <algorithm>
+
+TraceRecorder::TraceRecorder() {
+    clock.start();
+}
+
+void TraceRecorder::start() {
+    QMutexLocker locker(&mutex);
+    events.clear();
+    trackNames.clear();
+    trackNames.insert(DownloadTrack, "download");
+    origin.storeRelaxed(clock.nsecsElapsed() / 1000);
+    running = true;
+}
+
+void TraceRecorder::stop() {
+    QMutexLocker locker(&mutex);
+    running = false;
+}
+
+bool TraceRecorder::isRunning() const {
+    QMutexLocker locker(&mutex);
+    return running;
+}
+
+qint64 TraceRecorder::now() const {
+    return clock.nsecsElapsed() / 1000 - origin.loadRelaxed();
+}
+
+void TraceRecorder::setTrackName(int track, const QString &name) {
+    QMutexLocker locker(&mutex);
+    trackNames.insert(track, name);
+}
+
+void TraceRecorder::span(int track, const char *name, qint64 start, qint64 end, const QJsonObject &args) {
+    QMutexLocker locker(&mutex);
+    if (running) {
+        events.append({'X', track, name, start, qMax<qint64>(0, end - start), args});
+    }
+}
+
+void TraceRecorder::instant(int track, const char *name, const QJsonObject &args) {
+    qint64 time = now();
+    QMutexLocker locker(&mutex);
+    if (running) {
+        events.append({'i', track, name, time, 0, args});
+    }
+}
+
+void TraceRecorder::counter(const char *name, const QString &series, double value) {
+    qint64 time = now();
+    QMutexLocker locker(&mutex);
+    if (running) {
+        events.append({'C', DownloadTrack, name, time, 0, QJsonObject{{series, value}}});
+    }
+}
+
+static QJsonObject spread(QVector<double> values, const char *unit) {
+    std::sort(values.begin(), values.end());
+    double total = 0;
+    for (double value : values) {
+        total += value;
+    }
+    auto at = [&values](double fraction) {
+        return values[qMin<int>(values.size() - 1, int(fraction * values.size()))];
+    };
+    QString suffix = QString::fromLatin1(unit);
+    return {{"count", values.size()}, {"total" + suffix, total}, {"min" + suffix, values.first()},
+            {"p50" + suffix, at(0.5)}, {"p95" + suffix, at(0.95)}, {"max" + suffix, values.last()}};
+}
+
+QJsonObject TraceRecorder::summary() const {
+    QMutexLocker locker(&mutex);
+
+    QMap<QString, QVector<double>> spans;
+    QMap<QString, int> instants;
+    QVector<double> segmentRates;
+    qint64 end = 0;
+    for (const Event &event : events) {
+        end = qMax(end, event.start + event.duration);
+        if (event.phase == 'X') {
+            spans[event.name].append(event.duration / 1000.0);
+            qint64 bytes = event.args.value("bytes").toInteger();
+            if (qstrcmp(event.name, "segment") == 0 && bytes > 0 && event.duration > 0) {
+                segmentRates.append(bytes / (event.duration / 1e6) / (1024 * 1024));
+            }
+        } else if (event.phase == 'i') {
+            instants[event.name]++;
+        }
+    }
+
+    QJsonObject phases;
+    for (auto it = spans.cbegin(); it != spans.cend(); ++it) {
+        phases.insert(it.key(), spread(it.value(), "Ms"));
+    }
+    QJsonObject counts;
+    for (auto it = instants.cbegin(); it != instants.cend(); ++it) {
+        counts.insert(it.key(), it.value());
+    }
+
+    QJsonObject result{{"durationMs", end / 1000.0}, {"spans", phases}, {"events", counts}};
+    if (!segmentRates.isEmpty()) {
+        result.insert("segmentThroughput", spread(segmentRates, "MBps"));
+    }
+    return result;
+}
+
+bool TraceRecorder::write(const QString &path, const QJsonObject &summary, QString *error) const {
+    QJsonArray traceEvents;
+    {
+        QMutexLocker locker(&mutex);
+        traceEvents.append(QJsonObject{{"name", "process_name"}, {"ph", "M"}, {"pid", 1},
+                                       {"args", QJsonObject{{"name", "FastDoms"}}}});
+        for (auto it = trackNames.cbegin(); it != trackNames.cend(); ++it) {
+            traceEvents.append(QJsonObject{{"name", "thread_name"}, {"ph", "M"}, {"pid", 1}, {"tid", it.key()},
+                                           {"args", QJsonObject{{"name", it.value()}}}});
+        }
+        for (const Event &event : events) {
+            QJsonObject object{{"name", event.name}, {"ph", QString(QChar(event.phase))}, {"ts", event.start},
+                               {"pid", 1}, {"tid", event.track}};
+            if (event.phase == 'X') {
+                object.insert("dur", event.duration);
+            } else if (event.phase == 'i') {
+                object.insert("s", "t");
+            }
+            if (!event.args.isEmpty()) {
+                object.insert("args", event.args);
+            }
+            traceEvents.append(object);
+        }
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return false;
+    }
+    QJsonObject document{{"traceEvents", traceEvents}, {"displayTimeUnit", "ms"}, {"otherData", summary}};
+    if (file.write(QJsonDocument(document).toJson(QJsonDocument::Compact)) < 0) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return false;
+    }
+    return true;
+}
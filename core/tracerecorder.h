@@ -0,0 +1,61 @@
+#ifndef TRACERECORDER_H
+#define TRACERECORDER_H
+
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonObject>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+// Timeline of one download in Chrome trace-event format, to open in
+// chrome://tracing or Perfetto. Workers record a few spans per request and the
+// manager samples counters once per second, so it is cheap enough to leave on.
+// Thread-safe; times are microseconds since start().
+class TraceRecorder {
+public:
+    // Track 0 is the download itself; worker n records on track n + 1.
+    static const int DownloadTrack = 0;
+
+    TraceRecorder();
+
+    void start();
+    void stop();
+    bool isRunning() const;
+    qint64 now() const;
+
+    void setTrackName(int track, const QString &name);
+    // Span from start to end ("X" event); args show up in the viewer.
+    void span(int track, const char *name, qint64 start, qint64 end, const QJsonObject &args = {});
+    void instant(int track, const char *name, const QJsonObject &args = {});
+    // One value of a counter series; series of the same name share a graph.
+    void counter(const char *name, const QString &series, double value);
+
+    // Per span name: count, total, median, 95th percentile and maximum in ms;
+    // count of each instant event; segment throughput spread.
+    QJsonObject summary() const;
+    // The trace, with summary (usually summary() plus the caller's totals)
+    // under "otherData".
+    bool write(const QString &path, const QJsonObject &summary, QString *error = nullptr) const;
+
+private:
+    struct Event {
+        char phase;
+        int track;
+        const char *name;
+        qint64 start;
+        qint64 duration;
+        QJsonObject args;
+    };
+
+    mutable QMutex mutex;
+    // Started once and never restarted: workers read it without the mutex.
+    QElapsedTimer clock;
+    QAtomicInteger<qint64> origin;  // clock time of start(), in µs
+    bool running = false;
+    QVector<Event> events;
+    QHash<int, QString> trackNames;
+};
+
+#endif
@@ -0,0 +1,47 @@
+#include "transport.h"
+#include "qttransport.h"
+#ifdef FASTDOMS_HAVE_CURL
+#include "curltransport.h"
+#endif
+
+bool Transport::isAvailable(Backend backend) {
+    switch (backend) {
+    case QtNetwork:
+        return true;
+    case Curl:
+#ifdef FASTDOMS_HAVE_CURL
+        return true;
+#else
+        return false;
+#endif
+    default:
+        return false;
+    }
+}
+
+QString Transport::name(Backend backend) {
+    return backend == Curl ? "curl" : "qt";
+}
+
+bool Transport::fromName(const QString &name, Backend &backend) {
+    for (int i = 0; i < BackendCount; ++i) {
+        if (name.compare(Transport::name(Backend(i)), Qt::CaseInsensitive) == 0) {
+            backend = Backend(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+Transport *Transport::create(Backend backend, QObject *parent) {
+    switch (backend) {
+    case QtNetwork:
+        return new QtTransport(parent);
+#ifdef FASTDOMS_HAVE_CURL
+    case Curl:
+        return new CurlTransport(parent);
+#endif
+    default:
+        return nullptr;
+    }
+}
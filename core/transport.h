@@ -0,0 +1,90 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <QByteArray>
+#include <QHttp2Configuration>
+#include <QList>
+#include <QNetworkReply>
+#include <QObject>
+#include <QPair>
+#include <QUrl>
+
+struct TransportRequest {
+    QUrl url;
+    QList<QPair<QByteArray, QByteArray>> headers;
+    // Dropped when nothing arrives for that long; 0 = never.
+    int stallTimeoutMs = 0;
+    // Bytes of body buffered unread before the transfer stops reading the
+    // socket, so TCP backpressure slows the server down; 0 = unlimited.
+    qint64 readBufferSize = 0;
+    bool http2 = false;
+    QHttp2Configuration http2Configuration;
+};
+
+// One GET in flight, the part of QNetworkReply that DownloadThread relies on.
+// Errors use QNetworkReply's codes whatever the backend, with HTTP errors
+// mapped like Qt does; the body stays readable after finished().
+class TransportReply : public QObject {
+    Q_OBJECT
+
+public:
+    using QObject::QObject;
+
+    virtual QUrl url() const = 0;
+    // 0 until the response headers are in.
+    virtual int statusCode() const = 0;
+    virtual QByteArray rawHeader(const QByteArray &name) const = 0;
+    // -1 when the server does not say.
+    virtual qint64 contentLength() const = 0;
+    virtual bool http2WasUsed() const = 0;
+
+    virtual qint64 bytesAvailable() const = 0;
+    virtual qint64 read(char *data, qint64 maxSize) = 0;
+    // Drops what is buffered.
+    virtual void skip() = 0;
+
+    // Emits finished() with OperationCanceledError unless already finished.
+    virtual void abort() = 0;
+    virtual bool isFinished() const = 0;
+    bool isRunning() const { return !isFinished(); }
+    virtual QNetworkReply::NetworkError error() const = 0;
+    virtual QString errorString() const = 0;
+
+signals:
+    // A new connection is being opened for this request; not emitted when
+    // it reuses one.
+    void socketStartedConnecting();
+    void requestSent();
+    void metaDataChanged();
+    void readyRead();
+    void finished();
+};
+
+// HTTP engine of one I/O thread: transports and their replies are only used
+// from the thread they live in, and replies are children of their transport.
+class Transport : public QObject {
+    Q_OBJECT
+
+public:
+    enum Backend {
+        QtNetwork,  // QNetworkAccessManager
+        Curl,       // libcurl multi handle, when built with it
+        BackendCount
+    };
+
+    static bool isAvailable(Backend backend);
+    static QString name(Backend backend);
+    // False for an unknown name.
+    static bool fromName(const QString &name, Backend &backend);
+    // Null if backend is not available.
+    static Transport *create(Backend backend, QObject *parent = nullptr);
+
+    using QObject::QObject;
+
+    virtual TransportReply *get(const TransportRequest &request) = 0;
+    // Opens a connection (TCP, and TLS for https) for a later get() to reuse;
+    // may do nothing.
+    virtual void preconnect(const QUrl &url, bool http2) = 0;
+};
+
+#endif
@@ -0,0 +1,241 @@
+#include "zsyncmanifest.h"
+#include "outputfile.h"
+#include <QBitArray>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QMultiHash>
+#include <cstring>
+
+// Rolling checksum of zsync (and rsync): a is the sum of the bytes, b the sum
+// weighted by distance to the end of the block, both modulo 2^16.
+static void weakSum(const uchar *data, int length, quint16 &a, quint16 &b) {
+    quint32 sumA = 0;
+    quint32 sumB = 0;
+    for (int i = 0; i < length; ++i) {
+        sumA += data[i];
+        sumB += quint32(length - i) * data[i];
+    }
+    a = quint16(sumA);
+    b = quint16(sumB);
+}
+
+int ZsyncManifest::blockCount() const {
+    return blockSize > 0 ? int((length + blockSize - 1) / blockSize) : 0;
+}
+
+bool ZsyncManifest::parse(const QByteArray &document, ZsyncManifest &manifest, QString *error) {
+    manifest = ZsyncManifest();
+    int headerEnd = document.indexOf("\n\n");
+    if (!document.startsWith("zsync:") || headerEnd < 0) {
+        if (error) {
+            *error = "pas un fichier .zsync";
+        }
+        return false;
+    }
+
+    for (const QByteArray &line : document.left(headerEnd).split('\n')) {
+        int colon = line.indexOf(':');
+        QByteArray key = line.left(colon).trimmed();
+        QByteArray value = line.mid(colon + 1).trimmed();
+        if (key == "Filename") {
+            manifest.name = QString::fromUtf8(value);
+        } else if (key == "URL" && manifest.url.isEmpty()) {
+            manifest.url = QString::fromUtf8(value);
+        } else if (key == "Length") {
+            manifest.length = value.toLongLong();
+        } else if (key == "Blocksize") {
+            manifest.blockSize = value.toInt();
+        } else if (key == "SHA-1") {
+            manifest.sha1 = QByteArray::fromHex(value);
+        } else if (key == "Hash-Lengths") {
+            QList<QByteArray> lengths = value.split(',');
+            if (lengths.size() == 3) {
+                manifest.sequenceMatches = lengths[0].toInt();
+                manifest.rsumBytes = lengths[1].toInt();
+                manifest.checksumBytes = lengths[2].toInt();
+            }
+        }
+    }
+
+    if (manifest.blockSize <= 0 || manifest.length < 0 || manifest.sequenceMatches < 1 || manifest.sequenceMatches > 2
+        || manifest.rsumBytes < 1 || manifest.rsumBytes > 4 || manifest.checksumBytes < 3 || manifest.checksumBytes > 16) {
+        if (error) {
+            *error = "en-tête .zsync invalide";
+        }
+        manifest = ZsyncManifest();
+        return false;
+    }
+
+    int blocks = manifest.blockCount();
+    int entrySize = manifest.rsumBytes + manifest.checksumBytes;
+    const char *data = document.constData() + headerEnd + 2;
+    if (document.size() - headerEnd - 2 < qint64(blocks) * entrySize) {
+        if (error) {
+            *error = "sommes de contrôle des blocs incomplètes";
+        }
+        manifest = ZsyncManifest();
+        return false;
+    }
+
+    // Each rsum is the low rsumBytes of a, b as two big-endian 16-bit words.
+    quint16 mask = manifest.rsumBytes < 3 ? 0 : manifest.rsumBytes == 3 ? 0xff : 0xffff;
+    manifest.rsums.resize(blocks);
+    manifest.checksums.reserve(qint64(blocks) * manifest.checksumBytes);
+    for (int i = 0; i < blocks; ++i) {
+        uchar rsum[4] = {0, 0, 0, 0};
+        std::memcpy(rsum + 4 - manifest.rsumBytes, data, manifest.rsumBytes);
+        quint16 a = quint16((rsum[0] << 8) | rsum[1]) & mask;
+        quint16 b = quint16((rsum[2] << 8) | rsum[3]);
+        manifest.rsums[i] = (quint32(a) << 16) | b;
+        manifest.checksums.append(data + manifest.rsumBytes, manifest.checksumBytes);
+        data += entrySize;
+    }
+    return true;
+}
+
+bool ZsyncManifest::load(const QString &path, ZsyncManifest &manifest, QString *error) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return false;
+    }
+    return parse(file.readAll(), manifest, error);
+}
+
+bool ZsyncManifest::reuse(const QString &seedPath, OutputFile *output, RangeSet &reused, QString *error) const {
+    QFile seed(seedPath);
+    if (!seed.open(QIODevice::ReadOnly)) {
+        if (error) {
+            *error = seed.errorString();
+        }
+        return false;
+    }
+    qint64 size = seed.size();
+    if (size == 0 || length == 0) {
+        return true;
+    }
+    const uchar *data = seed.map(0, size);
+    if (!data) {
+        if (error) {
+            *error = seed.errorString();
+        }
+        return false;
+    }
+
+    int blocks = blockCount();
+    quint16 mask = rsumBytes < 3 ? 0 : rsumBytes == 3 ? 0xff : 0xffff;
+    QMultiHash<quint32, int> table;
+    table.reserve(blocks);
+    // Most offsets match no block: a bit per hashed rsum rules them out
+    // before the hash table lookup.
+    int filterBits = 1 << 16;
+    while (filterBits < blocks * 16 && filterBits < (1 << 26)) {
+        filterBits <<= 1;
+    }
+    auto filterIndex = [filterBits](quint32 key) {
+        return int((key * 2654435761u) >> 6) & (filterBits - 1);
+    };
+    QBitArray filter(filterBits);
+    for (int i = 0; i < blocks; ++i) {
+        table.insert(rsums[i], i);
+        filter.setBit(filterIndex(rsums[i]));
+    }
+
+    // The last block of the target was summed padded with zeros, so the
+    // seed is read as if followed by a block of zeros.
+    QByteArray padded(blockSize, 0);
+    auto window = [&](qint64 position) -> const uchar * {
+        if (position + blockSize <= size) {
+            return data + position;
+        }
+        padded.fill(0);
+        if (position < size) {
+            std::memcpy(padded.data(), data + position, size - position);
+        }
+        return reinterpret_cast<const uchar *>(padded.constData());
+    };
+    auto strongAt = [&](qint64 position) {
+        const char *bytes = reinterpret_cast<const char *>(window(position));
+        return QCryptographicHash::hash(QByteArrayView(bytes, blockSize), QCryptographicHash::Md4).left(checksumBytes);
+    };
+    auto keyAt = [&](qint64 position) {
+        quint16 a;
+        quint16 b;
+        weakSum(window(position), blockSize, a, b);
+        return (quint32(a & mask) << 16) | b;
+    };
+    auto sameChecksum = [this](int block, const QByteArray &strong) {
+        return std::memcmp(checksums.constData() + qint64(block) * checksumBytes, strong.constData(), checksumBytes) == 0;
+    };
+
+    QVector<bool> found(blocks, false);
+    qint64 position = 0;
+    quint16 a;
+    quint16 b;
+    weakSum(window(0), blockSize, a, b);
+    // Where the block after the last match would start, and which one it is.
+    qint64 nextPosition = -1;
+    int nextBlock = -1;
+
+    while (position < size) {
+        quint32 key = (quint32(a & mask) << 16) | b;
+        int matched = -1;
+        if (filter.testBit(filterIndex(key))) {
+            QByteArray strong;
+            for (auto it = table.constFind(key); it != table.constEnd() && it.key() == key; ++it) {
+                int block = it.value();
+                if (found[block]) {
+                    continue;
+                }
+                if (strong.isEmpty()) {
+                    strong = strongAt(position);
+                }
+                if (!sameChecksum(block, strong)) {
+                    continue;
+                }
+                // Short sums are only trusted for a run of blocks: this one
+                // must continue a match or be followed by the next block.
+                bool confirmed = sequenceMatches < 2 || block == blocks - 1
+                                 || (position == nextPosition && block == nextBlock)
+                                 || (keyAt(position + blockSize) == rsums[block + 1]
+                                     && sameChecksum(block + 1, strongAt(position + blockSize)));
+                if (!confirmed) {
+                    continue;
+                }
+
+                qint64 start = qint64(block) * blockSize;
+                qint64 bytes = qMin<qint64>(blockSize, length - start);
+                if (!output->writeAt(start, reinterpret_cast<const char *>(window(position)), bytes)) {
+                    if (error) {
+                        *error = output->errorString();
+                    }
+                    return false;
+                }
+                reused.add(start, start + bytes - 1);
+                found[block] = true;
+                matched = block;
+            }
+        }
+
+        if (matched >= 0) {
+            // Blocks do not overlap in the target: look for the next one
+            // right after this one.
+            position += blockSize;
+            nextPosition = position;
+            nextBlock = matched + 1;
+            if (position < size) {
+                weakSum(window(position), blockSize, a, b);
+            }
+            continue;
+        }
+
+        uchar out = data[position];
+        uchar in = position + blockSize < size ? data[position + blockSize] : 0;
+        a = quint16(a + in - out);
+        b = quint16(b + a - quint32(out) * blockSize);
+        position++;
+    }
+    return true;
+}
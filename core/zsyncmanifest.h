@@ -0,0 +1,41 @@
+#ifndef ZSYNCMANIFEST_H
+#define ZSYNCMANIFEST_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include "rangeset.h"
+
+class OutputFile;
+
+// Block checksums of a file, as published by zsyncmake next to it (".zsync"):
+// for each block a weak rolling sum and a truncated MD4. Any block of the
+// target found at any offset of an older local copy is reused; only the
+// others need to be downloaded.
+struct ZsyncManifest {
+    QString name;
+    QString url;                // as written: may be relative to the manifest
+    qint64 length = -1;
+    int blockSize = 0;
+    int sequenceMatches = 1;    // consecutive blocks that must match together
+    int rsumBytes = 4;
+    int checksumBytes = 16;
+    QByteArray sha1;            // of the whole file
+
+    QVector<quint32> rsums;     // (a << 16) | b, a truncated like in the file
+    QByteArray checksums;       // checksumBytes per block
+
+    bool isValid() const { return blockSize > 0 && length >= 0; }
+    int blockCount() const;
+
+    // Only the plain URL is read: targets compressed by zsyncmake (Z-URL,
+    // Z-Map2) are not supported.
+    static bool parse(const QByteArray &document, ZsyncManifest &manifest, QString *error = nullptr);
+    static bool load(const QString &path, ZsyncManifest &manifest, QString *error = nullptr);
+
+    // Blocking. Scans seed with the rolling sum and writes every block found
+    // to output, already open at length bytes; reused gets their ranges.
+    bool reuse(const QString &seedPath, OutputFile *output, RangeSet &reused, QString *error = nullptr) const;
+};
+
+#endif
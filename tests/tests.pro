@@ -0,0 +1,10 @@
+QT       = core network testlib
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+TARGET = fastdoms-tests
+
+include(../core/core.pri)
+
+SOURCES += \
+    tst_core.cpp
@@ -0,0 +1,370 @@
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRandomGenerator>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+#include <cstring>
+#include "crc32c.h"
+#include "downloadjournal.h"
+#include "outputfile.h"
+#include "rangeset.h"
+#include "segmentscheduler.h"
+#include "streamextractor.h"
+#include "zsyncmanifest.h"
+
+#ifdef FASTDOMS_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+// Pure units of the engine: nothing here touches the network.
+class CoreTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void rangeSetMergesAndSplits();
+    void journalRoundTrip();
+    void schedulerStealsSlowestTail();
+    void schedulerHedgesInEndgame();
+    void schedulerKeepsWindowAhead();
+    void crc32cCombines();
+    void zsyncReusesShiftedBlocks();
+    void tarStaysInsideDirectory();
+};
+
+static bool sameRanges(const QList<ByteRange> &actual, const QList<ByteRange> &expected) {
+    if (actual.size() != expected.size()) {
+        return false;
+    }
+    for (int i = 0; i < actual.size(); ++i) {
+        if (actual[i].start != expected[i].start || actual[i].end != expected[i].end) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CoreTest::rangeSetMergesAndSplits() {
+    RangeSet set;
+    set.add(0, 9);
+    set.add(10, 19);
+    set.add(30, 39);
+    QVERIFY(sameRanges(set.ranges(), {{0, 19}, {30, 39}}));
+    QCOMPARE(set.totalLength(), qint64(30));
+    QVERIFY(set.contains(5, 15));
+    QVERIFY(!set.contains(15, 35));
+
+    set.remove(5, 7);
+    QVERIFY(sameRanges(set.ranges(), {{0, 4}, {8, 19}, {30, 39}}));
+    QVERIFY(sameRanges(set.missing(50), {{5, 7}, {20, 29}, {40, 49}}));
+
+    set.add(0, 49);
+    QVERIFY(set.missing(50).isEmpty());
+    set.clear();
+    QVERIFY(set.isEmpty());
+}
+
+void CoreTest::journalRoundTrip() {
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    QString path = directory.filePath("file.part.json");
+
+    DownloadJournal journal;
+    journal.setPath(path);
+    journal.reset("http://example.com/file", 1000, "\"v1\"");
+    journal.completed().add(0, 99);
+    RangeSet onDisk = journal.completed();
+    onDisk.add(500, 599);
+    QVERIFY(journal.save(onDisk));
+
+    DownloadJournal loaded;
+    loaded.setPath(path);
+    QVERIFY(loaded.load());
+    QCOMPARE(loaded.size(), qint64(1000));
+    QCOMPARE(loaded.validator(), QByteArray("\"v1\""));
+    QVERIFY(loaded.matches(1000, "\"v1\""));
+    QVERIFY(!loaded.matches(1001, "\"v1\""));
+    QVERIFY(!loaded.matches(1000, "\"v2\""));
+    QVERIFY(sameRanges(loaded.completed().ranges(), {{0, 99}, {500, 599}}));
+
+    loaded.remove();
+    QVERIFY(!QFile::exists(path));
+}
+
+void CoreTest::schedulerStealsSlowestTail() {
+    SegmentScheduler scheduler(1024);
+    scheduler.reset({{0, 99999}}, 2);
+
+    SegmentScheduler::Range range;
+    int victim;
+    QVERIFY(scheduler.next(0, range, victim));
+    QCOMPARE(range.start, qint64(0));
+    QCOMPARE(range.end, qint64(49999));
+    QVERIFY(scheduler.next(1, range, victim));
+    QCOMPARE(range.start, qint64(50000));
+    QCOMPARE(victim, -1);
+    QVERIFY(!scheduler.hasPending());
+
+    // Worker 0 is well ahead: worker 1, with nothing received, is the one
+    // expected last, and gives up the untouched half of its range.
+    scheduler.updateProgress(0, 40000);
+    QVERIFY(scheduler.next(2, range, victim));
+    QCOMPARE(victim, 1);
+    QCOMPARE(range.start, qint64(75000));
+    QCOMPARE(range.end, qint64(99999));
+    QCOMPARE(scheduler.rangeOf(1).end, qint64(74999));
+}
+
+void CoreTest::schedulerHedgesInEndgame() {
+    // Too small to split: an idle worker can only race the other one.
+    SegmentScheduler scheduler(1024 * 1024);
+    scheduler.reset({{0, 999}}, 1);
+
+    SegmentScheduler::Range range;
+    int victim;
+    QVERIFY(scheduler.next(0, range, victim));
+    QVERIFY(!scheduler.next(1, range, victim));
+
+    int original;
+    QVERIFY(!scheduler.hedge(1, 0, 0, range, original));
+    QVERIFY(scheduler.hedge(1, 1024 * 1024, 0, range, original));
+    QCOMPARE(original, 0);
+    QCOMPARE(range.start, qint64(0));
+    QCOMPARE(range.end, qint64(999));
+    QVERIFY(scheduler.isRacing(0));
+
+    int loser;
+    SegmentScheduler::Range done = scheduler.finish(1, &loser);
+    QCOMPARE(loser, 0);
+    QCOMPARE(done.end, qint64(999));
+    QVERIFY(scheduler.isCancelled(0));
+}
+
+void CoreTest::schedulerKeepsWindowAhead() {
+    SegmentScheduler scheduler;
+    scheduler.setFrontFirst(100);
+    scheduler.setWindow(300);
+    scheduler.reset({{0, 999}}, 1);
+
+    SegmentScheduler::Range range;
+    int victim;
+    for (int worker = 0; worker < 3; ++worker) {
+        QVERIFY(scheduler.next(worker, range, victim));
+        QCOMPARE(range.start, qint64(worker * 100));
+        QCOMPARE(range.end, qint64(worker * 100 + 99));
+    }
+    // 300 is a full window past the reader.
+    QVERIFY(!scheduler.next(3, range, victim));
+    scheduler.setCursor(100);
+    QVERIFY(scheduler.next(3, range, victim));
+    QCOMPARE(range.start, qint64(300));
+
+    // A range fetched again goes before the rest.
+    scheduler.enqueue(50, 60);
+    QVERIFY(scheduler.next(4, range, victim));
+    QCOMPARE(range.start, qint64(50));
+    QCOMPARE(range.end, qint64(60));
+}
+
+void CoreTest::crc32cCombines() {
+    QByteArray check("123456789");
+    QCOMPARE(crc32c(0, check.constData(), check.size()), 0xE3069283u);
+
+    QByteArray data(100000, Qt::Uninitialized);
+    QRandomGenerator random(7);
+    for (char &byte : data) {
+        byte = char(random.bounded(256));
+    }
+    quint32 whole = crc32c(0, data.constData(), data.size());
+    for (qint64 split : {qint64(0), qint64(1), qint64(4095), qint64(50000), qint64(data.size())}) {
+        quint32 head = crc32c(0, data.constData(), split);
+        quint32 tail = crc32c(0, data.constData() + split, data.size() - split);
+        QCOMPARE(crc32cCombine(head, tail, data.size() - split), whole);
+        QCOMPARE(crc32c(head, data.constData() + split, data.size() - split), whole);
+    }
+}
+
+void CoreTest::zsyncReusesShiftedBlocks() {
+    const int blockSize = 1024;
+    QByteArray target(8 * blockSize + 300, Qt::Uninitialized);
+    QRandomGenerator random(42);
+    for (char &byte : target) {
+        byte = char(random.bounded(256));
+    }
+
+    // A manifest as zsyncmake writes it: rsum a and b, then the MD4, per block.
+    QByteArray document = QString("zsync: 0.6.2\nFilename: target\nBlocksize: %1\nLength: %2\n"
+                                  "Hash-Lengths: 1,4,16\nSHA-1: %3\n\n")
+                              .arg(blockSize).arg(target.size())
+                              .arg(QString(QCryptographicHash::hash(target, QCryptographicHash::Sha1).toHex()))
+                              .toUtf8();
+    for (qint64 start = 0; start < target.size(); start += blockSize) {
+        QByteArray block = target.mid(start, blockSize);
+        block.append(QByteArray(blockSize - block.size(), '\0'));
+        quint32 a = 0;
+        quint32 b = 0;
+        for (int i = 0; i < blockSize; ++i) {
+            a += uchar(block[i]);
+            b += quint32(blockSize - i) * uchar(block[i]);
+        }
+        document.append(char((a >> 8) & 0xff)).append(char(a & 0xff));
+        document.append(char((b >> 8) & 0xff)).append(char(b & 0xff));
+        document.append(QCryptographicHash::hash(block, QCryptographicHash::Md4));
+    }
+    ZsyncManifest manifest;
+    QString error;
+    QVERIFY2(ZsyncManifest::parse(document, manifest, &error), qPrintable(error));
+    QCOMPARE(manifest.blockCount(), 9);
+
+    // The older copy has 100 bytes inserted in block 2 and a byte changed in block 5.
+    QByteArray seed = target;
+    seed.insert(3000, QByteArray(100, 'x'));
+    seed[5 * blockSize + 100 + 200] = char(seed[5 * blockSize + 100 + 200] ^ 0xff);
+
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    QFile seedFile(directory.filePath("seed"));
+    QVERIFY(seedFile.open(QIODevice::WriteOnly));
+    seedFile.write(seed);
+    seedFile.close();
+
+    OutputFile output;
+    QString outputPath = directory.filePath("target.part");
+    QVERIFY(output.open(outputPath, manifest.length));
+    RangeSet reused;
+    QVERIFY2(manifest.reuse(seedFile.fileName(), &output, reused, &error), qPrintable(error));
+    output.close();
+    QVERIFY(sameRanges(reused.ranges(), {{0, 2 * blockSize - 1}, {3 * blockSize, 5 * blockSize - 1},
+                                         {6 * blockSize, target.size() - 1}}));
+
+    QFile result(outputPath);
+    QVERIFY(result.open(QIODevice::ReadOnly));
+    QByteArray written = result.readAll();
+    for (const ByteRange &range : reused.ranges()) {
+        QCOMPARE(written.mid(range.start, range.length()), target.mid(range.start, range.length()));
+    }
+}
+
+#ifdef FASTDOMS_HAVE_ZLIB
+static QByteArray tarEntry(const QByteArray &name, char type, const QByteArray &content = {},
+                           const QByteArray &link = {}) {
+    QByteArray header(512, '\0');
+    std::memcpy(header.data(), name.constData(), qMin<qsizetype>(name.size(), 100));
+    std::memcpy(header.data() + 100, "0000644", 7);
+    std::memcpy(header.data() + 108, "0000000", 7);
+    std::memcpy(header.data() + 116, "0000000", 7);
+    QByteArray size = QByteArray::number(content.size(), 8).rightJustified(11, '0');
+    std::memcpy(header.data() + 124, size.constData(), 11);
+    std::memcpy(header.data() + 136, "00000000000", 11);
+    header[156] = type;
+    std::memcpy(header.data() + 157, link.constData(), qMin<qsizetype>(link.size(), 100));
+    std::memcpy(header.data() + 257, "ustar\0" "00", 8);
+
+    std::memset(header.data() + 148, ' ', 8);
+    int sum = 0;
+    for (char byte : header) {
+        sum += uchar(byte);
+    }
+    QByteArray checksum = QByteArray::number(sum, 8).rightJustified(6, '0');
+    std::memcpy(header.data() + 148, checksum.constData(), 6);
+    header[154] = '\0';
+
+    QByteArray padded = content;
+    padded.append(QByteArray((512 - content.size() % 512) % 512, '\0'));
+    return header + padded;
+}
+
+static QByteArray gzip(const QByteArray &data) {
+    z_stream stream = {};
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+    QByteArray out(int(deflateBound(&stream, uLong(data.size()))) + 32, '\0');
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+    stream.avail_in = uInt(data.size());
+    stream.next_out = reinterpret_cast<Bytef *>(out.data());
+    stream.avail_out = uInt(out.size());
+    deflate(&stream, Z_FINISH);
+    out.resize(int(stream.total_out));
+    deflateEnd(&stream);
+    return out;
+}
+
+// Extracts the entries, then two zero blocks, into directory/out.
+static bool extract(const QTemporaryDir &directory, const QByteArray &entries, QString *message) {
+    QString archive = directory.filePath("archive.tar.gz");
+    QFile file(archive);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    QByteArray compressed = gzip(entries + QByteArray(1024, '\0'));
+    file.write(compressed);
+    file.close();
+
+    StreamExtractor extractor;
+    QSignalSpy spy(&extractor, &StreamExtractor::finished);
+    extractor.start(archive, directory.filePath("out"), "archive.tar");
+    extractor.finishInput(compressed.size());
+    if (spy.isEmpty() && !spy.wait(10000)) {
+        *message = "pas de fin d'extraction";
+        return false;
+    }
+    *message = spy.first().at(1).toString();
+    return spy.first().at(0).toBool();
+}
+#endif
+
+void CoreTest::tarStaysInsideDirectory() {
+#ifndef FASTDOMS_HAVE_ZLIB
+    QSKIP("built without zlib");
+#else
+    QString message;
+    {
+        QTemporaryDir directory;
+        QByteArray entries = tarEntry("dir/a.txt", '0', "hello") + tarEntry("/abs.txt", '0', "root")
+                             + tarEntry("dir/up", '2', {}, "../abs.txt");
+        QVERIFY2(extract(directory, entries, &message), qPrintable(message));
+        QFile a(directory.filePath("out/dir/a.txt"));
+        QVERIFY(a.open(QIODevice::ReadOnly));
+        QCOMPARE(a.readAll(), QByteArray("hello"));
+        // A leading '/' stays under the directory.
+        QVERIFY(QFile::exists(directory.filePath("out/abs.txt")));
+        QVERIFY(QFileInfo(directory.filePath("out/dir/up")).isSymLink());
+    }
+    {
+        QTemporaryDir directory;
+        QVERIFY(!extract(directory, tarEntry("../escape.txt", '0', "x"), &message));
+        QVERIFY(!QFile::exists(directory.filePath("escape.txt")));
+    }
+    {
+        QTemporaryDir directory;
+        QVERIFY(!extract(directory, tarEntry("passwd", '2', {}, "/etc/passwd"), &message));
+        QVERIFY(!QFileInfo(directory.filePath("out/passwd")).isSymLink());
+    }
+    {
+        QTemporaryDir directory;
+        QVERIFY(!extract(directory, tarEntry("dir/out", '2', {}, "../../x"), &message));
+        QVERIFY(!extract(directory, tarEntry("dir/back", '2', {}, "sub/../../.."), &message));
+    }
+    {
+        // A hard link copies its source, which must not lead out through a symlink.
+        QTemporaryDir directory;
+        QByteArray entries = tarEntry("inside.txt", '0', "in") + tarEntry("link", '2', {}, "inside.txt")
+                             + tarEntry("copy", '1', {}, "link");
+        QVERIFY(!extract(directory, entries, &message));
+        QVERIFY(!QFile::exists(directory.filePath("out/copy")));
+    }
+    {
+        // Nor may a symlink already in the directory lead mkpath out of it.
+        QTemporaryDir directory;
+        QTemporaryDir outside;
+        QVERIFY(QDir().mkpath(directory.filePath("out")));
+        QVERIFY(QFile::link(outside.path(), directory.filePath("out/elsewhere")));
+        QVERIFY(!extract(directory, tarEntry("elsewhere/sub/file.txt", '0', "x"), &message));
+        QVERIFY(!QFile::exists(outside.filePath("sub")));
+    }
+#endif
+}
+
+QTEST_GUILESS_MAIN(CoreTest)
+#include "tst_core.moc"